@@ -0,0 +1,59 @@
+/**
+ * @file I2C_Buffer.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief fixed capacity transfer buffer - the bytes are stored inline, so
+ *        a transaction never touches the heap
+ * @version 0.1
+ * @date 2019-06-15
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+template <int Capacity>
+class I2C_Buffer
+{
+public:
+    I2C_Buffer() : length(0){}
+
+    /**
+     * @brief append a byte
+     *
+     * @return false if the buffer is full - the byte is dropped
+     */
+    bool push_back(unsigned char byte)
+    {
+        if (length >= Capacity)
+            return false;
+        bytes[length++] = byte;
+        return true;
+    }
+
+    /**
+     * @brief set the number of valid bytes, e.g. before reading into the
+     *        buffer - clamped to the capacity
+     */
+    void resize(int size){length = (size < 0) ? 0 : ((size > Capacity) ? Capacity : size);}
+    void clear(){length = 0;}
+
+    unsigned char *data(){return bytes;}
+    unsigned char const *data() const {return bytes;}
+    int size() const {return length;}
+    bool empty() const {return length == 0;}
+    bool full() const {return length == Capacity;}
+    static int capacity(){return Capacity;}
+
+    unsigned char &operator[](int index){return bytes[index];}
+    unsigned char operator[](int index) const {return bytes[index];}
+
+    unsigned char *begin(){return bytes;}
+    unsigned char *end(){return bytes + length;}
+    unsigned char const *begin() const {return bytes;}
+    unsigned char const *end() const {return bytes + length;}
+
+private:
+    unsigned char bytes[Capacity];
+    int length;
+};
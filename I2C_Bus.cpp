@@ -0,0 +1,196 @@
+/**
+ * @file I2C_Bus.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief Implementation of the i2c adapter
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+#include <sys/ioctl.h>     //Needed for I2C port
+#include <linux/i2c-dev.h> //Needed for I2C port
+#include <fcntl.h>
+
+#include "I2C_Bus.hpp"
+
+#define TRACE_COMPONENT "I2C_Bus"
+#include "tracer.hpp"
+
+/**
+ * @brief Construct a new i2c bus object and open the adapter
+ * 
+ * @param adapter path of the adapter device node, e.g. /dev/i2c-1
+ */
+I2C_Bus::I2C_Bus(std::string const &adapter) : I2C_Bus(adapter, true)
+{
+}
+
+/**
+ * @brief Construct a new i2c bus object
+ * 
+ * @param name path of the adapter device node or name of a simulated bus
+ * @param openAdapter false for derived busses without a device node
+ */
+I2C_Bus::I2C_Bus(std::string const &name, bool openAdapter) : adapter(name), file_i2c(-1), timeout(-1), retries(-1)
+{
+    if (!openAdapter)
+    {
+        return;
+    }
+
+    //----- OPEN THE I2C BUS -----
+    if ((file_i2c = open(adapter.c_str(), O_RDWR)) < 0)
+    {
+        //ERROR HANDLING: you can check errno to see what went wrong
+        std::cout << "Failed to open the i2c bus " << adapter << std::endl;
+        return;
+    }
+}
+
+/**
+ * @brief Destroy the i2c bus object - closes the adapter
+ * 
+ */
+I2C_Bus::~I2C_Bus()
+{
+    Close();
+}
+
+/**
+ * @brief close the adapter; all device handles on this bus fail afterwards
+ * 
+ */
+void I2C_Bus::Close()
+{
+    if (file_i2c >= 0)
+    {
+        close(file_i2c);
+        file_i2c = -1;
+    }
+}
+
+/**
+ * @brief set the time the adapter waits for a transfer (I2C_TIMEOUT), e.g.
+ *        for a slave stretching the clock. The kernel counts in units of 10ms.
+ * 
+ * @param milliseconds timeout, rounded up to 10ms
+ * @return false if the adapter rejected the value
+ */
+bool I2C_Bus::SetTimeout(int milliseconds)
+{
+    timeout = milliseconds;
+    if ((file_i2c >= 0) && (ioctl(file_i2c, I2C_TIMEOUT, (milliseconds + 9) / 10) < 0))
+    {
+        std::cout << "i2c bus " << adapter << ": failed to set timeout " << milliseconds << "ms" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief set how often the adapter repeats a transfer that lost
+ *        arbitration (I2C_RETRIES)
+ * 
+ * @param count number of retries
+ * @return false if the adapter rejected the value
+ */
+bool I2C_Bus::SetRetries(int count)
+{
+    retries = count;
+    if ((file_i2c >= 0) && (ioctl(file_i2c, I2C_RETRIES, count) < 0))
+    {
+        std::cout << "i2c bus " << adapter << ": failed to set retries " << count << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief transfer a sequence of messages as one combined transaction.
+ *        Every message carries its own slave address, so devices do not
+ *        need an I2C_SLAVE ioctl or a file descriptor of their own.
+ * 
+ * @param messages messages to transfer (addr, flags, len, buf)
+ * @param count number of messages
+ * @return true if all messages were transferred - otherwise errno tells why
+ *         (see I2C_Device for the classification)
+ */
+bool I2C_Bus::Transfer(struct i2c_msg *messages, const int count)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} messages", count);
+
+    if (file_i2c < 0)
+    {
+        TRACE_ERROR(TRACE_NO_ADDRESS, "adapter not open");
+        errno = EBADF;
+        return false;
+    }
+
+    if ((count <= 0) || (count > MaxMessages))
+    {
+        TRACE_ERROR(TRACE_NO_ADDRESS, "invalid number of messages {}", count);
+        errno = EINVAL;
+        return false;
+    }
+
+    struct i2c_rdwr_ioctl_data transaction;
+    transaction.msgs = messages;
+    transaction.nmsgs = count;
+
+    if (ioctl(file_i2c, I2C_RDWR, &transaction) != count) //I2C_RDWR returns the number of messages transferred
+    {
+        //ERROR HANDLING: i2c transaction failed
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief transfer messages to several devices as one combined transaction
+ *        and account every device's share in its statistics: operation by
+ *        the direction of its messages, bytes by their length and the
+ *        transfer time split by the number of messages. A failed transfer
+ *        is not accounted - the kernel does not tell which device refused,
+ *        so the callers repeat it device by device.
+ * 
+ * @param messages messages to transfer
+ * @param count number of messages
+ * @param devices device of every message - consecutive messages of one
+ *        device form its share
+ * @return true if all messages were transferred
+ */
+bool I2C_Bus::TransferBatch(struct i2c_msg *messages, const int count, I2C_Interface *const *devices)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!Transfer(messages, count))
+    {
+        return false;
+    }
+    std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    int first = 0;
+    while (first < count)
+    {
+        int end = first;
+        int length = 0;
+        bool written = false, read = false;
+        for (; (end < count) && (devices[end] == devices[first]); end++)
+        {
+            length += messages[end].len;
+            if (messages[end].flags & I2C_M_RD)
+                read = true;
+            else
+                written = true;
+        }
+        I2C_Operation op = (written && read) ? I2C_OP_WRITEREAD : (read ? I2C_OP_READ : I2C_OP_WRITE);
+        devices[first]->Account(op, elapsed * (end - first) / count, true, length);
+        first = end;
+    }
+    return true;
+}
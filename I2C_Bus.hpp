@@ -0,0 +1,64 @@
+/**
+ * @file I2C_Bus.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief declaration of an i2c adapter (one file descriptor per bus)
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_Interface.hpp"
+
+#include <string>
+#include <linux/i2c.h>     //Needed for struct i2c_msg
+#include <linux/i2c-dev.h> //Needed for I2C_RDWR_IOCTL_MAX_MSGS
+
+class I2C_Bus
+{
+public:
+    I2C_Bus(std::string const &adapter);
+    virtual ~I2C_Bus();
+
+    I2C_Bus(I2C_Bus const &) = delete;
+    I2C_Bus &operator=(I2C_Bus const &) = delete;
+
+    /**
+     * @brief maximum number of messages the kernel accepts in one I2C_RDWR
+     * 
+     */
+    static const int MaxMessages = I2C_RDWR_IOCTL_MAX_MSGS;
+
+    virtual bool Transfer(struct i2c_msg *messages, const int count);
+    bool TransferBatch(struct i2c_msg *messages, const int count, I2C_Interface *const *devices);
+
+    virtual bool SetTimeout(int milliseconds);
+    virtual bool SetRetries(int retries);
+
+    void Close();
+    bool isOpen(){return file_i2c >= 0;}
+    std::string const &getAdapter(){return adapter;}
+    int getTimeout(){return timeout;}
+    int getRetries(){return retries;}
+
+protected:
+    I2C_Bus(std::string const &name, bool openAdapter);
+
+private:
+    /**
+     * @brief path of the adapter, e.g. /dev/i2c-1
+     * 
+     */
+    std::string adapter;
+    int file_i2c;
+    /**
+     * @brief adapter timeout in ms and retries after a lost arbitration -
+     *        -1 while the kernel default is used
+     * 
+     */
+    int timeout;
+    int retries;
+};
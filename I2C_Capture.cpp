@@ -0,0 +1,310 @@
+/**
+ * @file I2C_Capture.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief record i2c traffic to a binary capture and replay it later
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "I2C_Capture.hpp"
+
+#define TRACE_COMPONENT "I2C_ReplayBus"
+#include "tracer.hpp"
+
+static const char CaptureMagic[6] = {'I', '2', 'C', 'C', 'A', 'P'};
+static const unsigned short CaptureVersion = 1;
+
+static void Put(std::ofstream &out, unsigned long long value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out.put((char)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static bool Get(std::ifstream &in, unsigned long long &value, int bytes)
+{
+    value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        int c = in.get();
+        if (c == EOF)
+            return false;
+        value |= (unsigned long long)(c & 0xFF) << (8 * i);
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new recording bus and write the capture header
+ * 
+ * @param target bus executing the transfers
+ * @param file capture file (overwritten)
+ */
+I2C_RecordingBus::I2C_RecordingBus(I2C_Bus &target, std::string const &file)
+    : I2C_Bus(target.getAdapter(), false),
+      bus(&target),
+      capture(file.c_str(), std::ios::binary | std::ios::trunc),
+      started(std::chrono::steady_clock::now()),
+      records(0),
+      transfers(0)
+{
+    if (!capture.good())
+    {
+        std::cout << "Failed to open the capture file " << file << std::endl;
+        return;
+    }
+    capture.write(CaptureMagic, sizeof(CaptureMagic));
+    Put(capture, CaptureVersion, 2);
+}
+
+/**
+ * @brief Destroy the recording bus - flushes and closes the capture
+ * 
+ */
+I2C_RecordingBus::~I2C_RecordingBus()
+{
+    capture.close();
+}
+
+/**
+ * @brief forward the transfer to the target bus and log every message
+ */
+bool I2C_RecordingBus::Transfer(struct i2c_msg *messages, const int count)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ret = bus->Transfer(messages, count);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    int error = errno; // writing the capture must not hide why the transfer failed
+
+    if ((count <= 0) || !capture.good())
+    {
+        return ret;
+    }
+
+    unsigned long long offset = std::chrono::duration_cast<std::chrono::nanoseconds>(start - started).count();
+    unsigned long long share = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / count;
+
+    std::lock_guard<std::mutex> guard(lock);
+    transfers++;
+    for (int i = 0; i < count; i++)
+    {
+        bool read = (messages[i].flags & I2C_M_RD) != 0;
+        // data of a failed read is undefined - it is not recorded
+        unsigned short length = (read && !ret) ? 0 : messages[i].len;
+        Put(capture, offset, 8);
+        Put(capture, share, 4);
+        Put(capture, transfers, 4);
+        Put(capture, messages[i].addr, 2);
+        Put(capture, read ? 1 : 0, 1);
+        Put(capture, ret ? 1 : 0, 1);
+        Put(capture, length, 2);
+        capture.write((char const *)messages[i].buf, length);
+        records++;
+    }
+    errno = error;
+    return ret;
+}
+
+/**
+ * @brief read all records of a capture
+ * 
+ * @param file capture file
+ * @param records records in capture order
+ * @return false if the file is missing or not a capture
+ */
+bool I2C_ReplayBus::Load(std::string const &file, std::vector<I2C_CaptureRecord> &records)
+{
+    std::ifstream in(file.c_str(), std::ios::binary);
+    char magic[sizeof(CaptureMagic)];
+    unsigned long long value;
+    if (!in.read(magic, sizeof(magic)) || (std::memcmp(magic, CaptureMagic, sizeof(magic)) != 0) ||
+        !Get(in, value, 2) || (value != CaptureVersion))
+    {
+        return false;
+    }
+
+    records.clear();
+    I2C_CaptureRecord record;
+    while (Get(in, record.start, 8))
+    {
+        unsigned long long length;
+        if (!Get(in, value, 4))
+            return false;
+        record.duration = value;
+        if (!Get(in, value, 4))
+            return false;
+        record.transfer = value;
+        if (!Get(in, value, 2))
+            return false;
+        record.address = value;
+        if (!Get(in, value, 1))
+            return false;
+        record.read = (value & 1) != 0;
+        if (!Get(in, value, 1))
+            return false;
+        record.result = value != 0;
+        if (!Get(in, length, 2))
+            return false;
+        record.payload.resize(length);
+        if ((length > 0) && !in.read((char *)record.payload.data(), length))
+            return false;
+        records.push_back(record);
+    }
+    return true;
+}
+
+/**
+ * @brief Construct a new replay bus from a capture
+ * 
+ * @param file capture file
+ */
+I2C_ReplayBus::I2C_ReplayBus(std::string const &file)
+    : I2C_Bus(file, false),
+      loaded(false),
+      timeScale(1.0),
+      paceStart(false),
+      started(std::chrono::steady_clock::now()),
+      divergences(0)
+{
+    std::vector<I2C_CaptureRecord> records;
+    if (!Load(file, records))
+    {
+        std::cout << "Failed to load the capture file " << file << std::endl;
+        return;
+    }
+    for (auto const &record : records)
+    {
+        pending[record.address].push_back(record);
+    }
+    loaded = true;
+}
+
+I2C_ReplayBus::~I2C_ReplayBus()
+{
+}
+
+/**
+ * @brief set the timing of the replay
+ * 
+ * @param scale factor applied to the recorded times - 0 replays without delay
+ * @param pace additionally wait until the recorded start time of a message
+ */
+void I2C_ReplayBus::SetTiming(double scale, bool pace)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    timeScale = scale;
+    paceStart = pace;
+    started = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief number of recorded messages not yet replayed
+ */
+unsigned long I2C_ReplayBus::getRemaining()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned long remaining = 0;
+    for (auto const &address : pending)
+        remaining += address.second.size();
+    return remaining;
+}
+
+/**
+ * @brief drop the records of a recorded transfer which were not replayed
+ *        - its later messages were never sent, e.g. after a NACK
+ *
+ * @param transfer number of the recorded transfer
+ */
+void I2C_ReplayBus::Discard(unsigned long transfer)
+{
+    for (auto &address : pending)
+    {
+        std::deque<I2C_CaptureRecord> &queue = address.second;
+        queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                   [transfer](I2C_CaptureRecord const &record) { return record.transfer == transfer; }),
+                    queue.end());
+    }
+}
+
+/**
+ * @brief serve the messages from the capture. Records are matched per
+ *        address in capture order, so the replayed driver may group its
+ *        messages differently than the recorded one. A message without a
+ *        matching record (other address, direction or written data) counts
+ *        as divergence and fails like a NACK. When a transfer fails, the
+ *        remaining records of the recorded transfers it touched are
+ *        dropped, so the following transfers stay in step with the
+ *        capture.
+ */
+bool I2C_ReplayBus::Transfer(struct i2c_msg *messages, const int count)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} messages", count);
+
+    std::chrono::microseconds busTime(0);
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+    bool ret = true;
+    int error = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        // recorded transfers the messages were matched against
+        std::vector<unsigned long> touched;
+        for (int i = 0; (i < count) && ret; i++)
+        {
+            std::deque<I2C_CaptureRecord> &queue = pending[messages[i].addr];
+            bool read = (messages[i].flags & I2C_M_RD) != 0;
+            if (!queue.empty() && (std::find(touched.begin(), touched.end(), queue.front().transfer) == touched.end()))
+            {
+                touched.push_back(queue.front().transfer);
+            }
+            if (queue.empty() || (queue.front().read != read) ||
+                (!read && ((queue.front().payload.size() != messages[i].len) ||
+                           !std::equal(queue.front().payload.begin(), queue.front().payload.end(), messages[i].buf))))
+            {
+                divergences++;
+                error = EREMOTEIO;
+                ret = false;
+                break;
+            }
+
+            I2C_CaptureRecord const &record = queue.front();
+            if (read)
+            {
+                std::memcpy(messages[i].buf, record.payload.data(), std::min<size_t>(record.payload.size(), messages[i].len));
+            }
+            if (paceStart && (i == 0))
+            {
+                due = started + std::chrono::nanoseconds((long long)(record.start * timeScale));
+            }
+            busTime += std::chrono::microseconds((long long)(record.duration * timeScale));
+            ret = record.result;
+            error = ENXIO; // the capture keeps the result only, not the reason
+            queue.pop_front();
+        }
+        if (!ret)
+        {
+            for (unsigned long transfer : touched)
+                Discard(transfer);
+        }
+    }
+
+    std::this_thread::sleep_until(due);
+    if (busTime.count() > 0)
+    {
+        std::this_thread::sleep_for(busTime);
+    }
+    if (!ret)
+    {
+        errno = error;
+    }
+    return ret;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file I2C_Capture.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief record i2c traffic to a binary capture and replay it later
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_Bus.hpp"
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/* capture file format (all values little endian)
+   header: "I2CCAP" u16 version
+   record: u64 start   - ns since start of the capture
+           u32 duration- us of the transfer share of this message
+           u32 transfer- number of the transfer the message belongs to
+           u16 address
+           u8  flags   - bit0: read
+           u8  result  - 1: transfer acknowledged
+           u16 length
+           length bytes payload (written data / data read)
+ */
+
+/**
+ * @brief one message of a capture
+ * 
+ */
+struct I2C_CaptureRecord
+{
+    unsigned long long start;
+    unsigned long duration;
+    unsigned long transfer;
+    unsigned short address;
+    bool read;
+    bool result;
+    std::vector<unsigned char> payload;
+};
+
+/**
+ * @brief bus wrapper logging every message of the target bus
+ * 
+ */
+class I2C_RecordingBus : public I2C_Bus
+{
+public:
+    I2C_RecordingBus(I2C_Bus &target, std::string const &file);
+    ~I2C_RecordingBus();
+
+    virtual bool Transfer(struct i2c_msg *messages, const int count);
+    virtual bool SetTimeout(int milliseconds){return bus->SetTimeout(milliseconds);}
+    virtual bool SetRetries(int retries){return bus->SetRetries(retries);}
+
+    bool isRecording(){return capture.good();}
+    unsigned long getRecords(){return records;}
+
+private:
+    std::mutex lock;
+    I2C_Bus *bus;
+    std::ofstream capture;
+    std::chrono::steady_clock::time_point started;
+    unsigned long records;
+    unsigned long transfers;
+};
+
+/**
+ * @brief bus serving a capture - reads return the recorded data
+ * 
+ */
+class I2C_ReplayBus : public I2C_Bus
+{
+public:
+    I2C_ReplayBus(std::string const &file);
+    ~I2C_ReplayBus();
+
+    virtual bool Transfer(struct i2c_msg *messages, const int count);
+
+    void SetTiming(double scale, bool pace);
+
+    bool isLoaded(){return loaded;}
+    unsigned long getRemaining();
+    unsigned long getDivergences(){return divergences;}
+
+    static bool Load(std::string const &file, std::vector<I2C_CaptureRecord> &records);
+
+private:
+    void Discard(unsigned long transfer);
+
+    std::mutex lock;
+    bool loaded;
+    std::map<int, std::deque<I2C_CaptureRecord> > pending;
+    double timeScale;
+    bool paceStart;
+    std::chrono::steady_clock::time_point started;
+    unsigned long divergences;
+};
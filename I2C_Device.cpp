@@ -9,38 +9,48 @@
  * MIT license - see license file
  */
 
-#include <iostream>
+#include <cerrno>
 #include <iomanip>
-#include <typeinfo> 
-#include <unistd.h>
-#include <sys/ioctl.h>     //Needed for I2C port
-#include <linux/i2c-dev.h> //Needed for I2C port
-#include <fcntl.h>
-#include <vector>
+#include <thread>
+#include <linux/i2c.h>     //Needed for I2C_RDWR
 
 #include "I2C_Device.hpp"
 
+#define TRACE_COMPONENT "I2C_Device"
+#include "tracer.hpp"
+
+const I2C_RetryPolicy I2C_Device::DefaultRetryPolicy = {2, std::chrono::microseconds(500), 3, std::chrono::milliseconds(10000)};
+
 /**
- * @brief Construct a new i2c device::i2c device object
+ * @brief errors worth another attempt: lost arbitration, clock stretched
+ *        beyond the adapter timeout, bus busy or a garbled transfer
  * 
  */
-I2C_Device::I2C_Device(int device_id, bool verb) : addr(device_id),verbose(verb) 
+static bool IsTransient(int error)
 {
-    //----- OPEN THE I2C BUS -----
-    char *filename = (char *)"/dev/i2c-1";
-    if ((file_i2c = open(filename, O_RDWR)) < 0)
-    {
-        //ERROR HANDLING: you can check errno to see what went wrong
-        std::cout << "Failed to open the i2c bus" << std::endl;
-        return;
-    }
+    return (error == EAGAIN) || (error == ETIMEDOUT) || (error == EBUSY) ||
+           (error == EIO) || (error == EPROTO) || (error == EBADMSG) || (error == EINTR);
+}
 
-    if (ioctl(file_i2c, I2C_SLAVE, addr) < 0)
-    {
-        std::cout << "Failed to acquire bus access and / or talk to slave." << std::endl;
-        //ERROR HANDLING; you can check errno to see what went wrong
-        return;
-    }
+/**
+ * @brief errors of the adapter or the caller - they do not tell anything
+ *        about the device and do not lead to a quarantine
+ * 
+ */
+static bool IsAdapterError(int error)
+{
+    return (error == EBADF) || (error == EINVAL) || (error == EOPNOTSUPP) || (error == ENOTTY);
+}
+
+/**
+ * @brief Construct a new i2c device::i2c device object
+ * 
+ * @param i2c_bus adapter the device is connected to
+ * @param device_id i2c address of the device
+ */
+I2C_Device::I2C_Device(I2C_Bus &i2c_bus, int device_id) : bus(&i2c_bus), addr(device_id), policy(DefaultRetryPolicy), failures(0), quarantinedUntil(0)
+{
+    ResetStats();
 }
 
 /**
@@ -60,20 +70,19 @@ I2C_Device::~I2C_Device()
 bool I2C_Device::WriteByte(unsigned char const *buffer, const int length)
 {
     bool ret = true;
-    if (verbose)
-    {
-      std::cout << "\t" << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << getAddress() << ") - " << length << std::endl;
-      std::vector<char> vec(buffer, buffer + length);
-      std::cout << "\t" << "\t" ;
-      for (int i: vec) {
-         std::cout << "-" << i << "-";
-      }
-      std::cout << '\n';
-    }
-    if (write(file_i2c, buffer, length) != length) //write() returns the number of bytes actually written, if it doesn't match then an error occurred (e.g. no response from the device)
+    TRACE_BYTES_DEBUG(addr, buffer, length);
+    struct i2c_msg message;
+    message.addr = addr;
+    message.flags = 0;
+    message.len = length;
+    message.buf = const_cast<unsigned char *>(buffer);
+    if (!Execute(I2C_OP_WRITE, &message, 1, length)) //no ACK from the device or adapter not available
     {
         /* ERROR HANDLING: i2c transaction failed */
-        std::cout << "Failed to write to the i2c bus." << std::endl;
+        int error = errno;
+        if (error != EHOSTDOWN)
+            TRACE_ERROR(addr, "write failed, errno {}", error);
+        errno = error;
         ret = false;
     }
     return ret;
@@ -88,27 +97,318 @@ bool I2C_Device::WriteByte(unsigned char const *buffer, const int length)
  */
 bool I2C_Device::ReadByte(unsigned char *buffer, const int length)
 {
-    if (verbose)
-        std::cout << "\t" << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << getAddress() << ")-" << length << std::endl;
+    TRACE_DEBUG(addr, "{} bytes", length);
     int16_t result = 0;
     if (length > 2)
     {
         return false; // there is no reply for DS1621 with more than 2 bytes
     }
 
-    if (read(file_i2c, buffer, length) != length) //read() returns the number of bytes actually read, if it doesn't match then an error occurred (e.g. no response from the device)
+    struct i2c_msg message;
+    message.addr = addr;
+    message.flags = I2C_M_RD;
+    message.len = length;
+    message.buf = buffer;
+    if (!Execute(I2C_OP_READ, &message, 1, length)) //no ACK from the device or adapter not available
     {
         //ERROR HANDLING: i2c transaction failed
-        std::cout << "Failed to read from the i2c bus." << std::endl;
+        int error = errno;
+        if (error != EHOSTDOWN)
+            TRACE_ERROR(addr, "read failed, errno {}", error);
+        errno = error;
         return false;
     }
-    else
+    TRACE_BYTES_DEBUG(addr, buffer, length);
+    return true;
+}
+
+/**
+ * @brief write the command/pointer byte(s) and read the reply in one
+ *        combined transaction (repeated START, no STOP in between)
+ * 
+ * @param wbuffer bytes to write (e.g. DS1631 command)
+ * @param wlength number of bytes to write
+ * @param rbuffer buffer receiving the reply
+ * @param rlength number of bytes to read
+ * @return true if both messages were transferred
+ */
+bool I2C_Device::WriteRead(unsigned char const *wbuffer, const int wlength,
+                           unsigned char *rbuffer, const int rlength)
+{
+    TRACE_DEBUG(addr, "{} written / {} read", wlength, rlength);
+
+    struct i2c_msg messages[2];
+    messages[0].addr = addr;
+    messages[0].flags = 0;
+    messages[0].len = wlength;
+    messages[0].buf = const_cast<unsigned char *>(wbuffer);
+    messages[1].addr = addr;
+    messages[1].flags = I2C_M_RD;
+    messages[1].len = rlength;
+    messages[1].buf = rbuffer;
+
+    if (!Execute(I2C_OP_WRITEREAD, messages, 2, wlength + rlength))
     {
-        if (verbose)
-            std::cout << "Data read 0: " << std::hex << std::setw(2) << std::setfill('0') << (int)buffer[0] << std::endl;
-        if (length == 2)
-            if (verbose)
-                std::cout << "Data read 1: " << std::hex << std::setw(2) << std::setfill('0') << (int)buffer[1] << std::endl;
+        //ERROR HANDLING: i2c transaction failed
+        int error = errno;
+        if (error != EHOSTDOWN)
+            TRACE_ERROR(addr, "write/read failed, errno {}", error);
+        errno = error;
+        return false;
     }
+
+    TRACE_BYTES_DEBUG(addr, rbuffer, rlength);
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief false while the device is quarantined
+ * 
+ */
+bool I2C_Device::isAvailable()
+{
+    long long until = quarantinedUntil.load(std::memory_order_relaxed);
+    return (until == 0) || (std::chrono::steady_clock::now().time_since_epoch().count() >= until);
+}
+
+/**
+ * @brief transfer the messages of one transaction with the retry policy
+ *        of the device and account the result
+ * 
+ * @param op operation for the statistics
+ * @param messages messages of the transaction
+ * @param count number of messages
+ * @param length bytes of the transaction
+ * @return true if the transaction succeeded - otherwise errno holds the
+ *         error of the last attempt (EHOSTDOWN: skipped, device quarantined)
+ */
+bool I2C_Device::Execute(I2C_Operation op, struct i2c_msg *messages, const int count, const int length)
+{
+    if (!isAvailable())
+    {
+        counters[op].skipped.fetch_add(1, std::memory_order_relaxed);
+        errno = EHOSTDOWN;
+        return false;
+    }
+
+    // a device that just left the quarantine gets a single attempt
+    bool probing = (policy.quarantineAfter > 0) && (failures.load(std::memory_order_relaxed) >= policy.quarantineAfter);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::microseconds backoff = policy.backoff;
+    int attempt = 0;
+    int error = 0;
+    bool ok;
+    while (!(ok = bus->Transfer(messages, count)))
+    {
+        error = errno;
+        if (probing || (attempt >= policy.retries) || !IsTransient(error))
+            break;
+        attempt++;
+        TRACE_INFO(addr, "errno {} - retry {} in {}us", error, attempt, backoff.count());
+        std::this_thread::sleep_for(backoff);
+        backoff *= 2;
+    }
+    counters[op].retries.fetch_add(attempt, std::memory_order_relaxed);
+    Record(op, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start), ok, length);
+
+    if (ok)
+    {
+        failures.store(0, std::memory_order_relaxed);
+        quarantinedUntil.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (!IsAdapterError(error))
+    {
+        int failed = failures.fetch_add(1, std::memory_order_relaxed) + 1;
+        if ((policy.quarantineAfter > 0) && (failed >= policy.quarantineAfter))
+        {
+            std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + policy.quarantineTime;
+            quarantinedUntil.store(until.time_since_epoch().count(), std::memory_order_relaxed);
+            TRACE_ERROR(addr, "quarantined for {}ms after {} failures, errno {}", policy.quarantineTime.count(), failed, error);
+        }
+    }
+    errno = error;
+    return false;
+}
+
+/**
+ * @brief transfer a batch of several devices with the retry policy of
+ *        this device. Only transient errors are retried - a missing
+ *        acknowledge does not tell which device refused, so it neither
+ *        counts as failure of this device nor leads to its quarantine.
+ * 
+ * @param i2c_bus adapter of the devices
+ * @param messages messages of the batch
+ * @param count number of messages
+ * @param devices device of every message (see I2C_Bus::TransferBatch)
+ * @return true if all messages were transferred - otherwise errno holds
+ *         the error of the last attempt
+ */
+bool I2C_Device::TransferBatch(I2C_Bus &i2c_bus, struct i2c_msg *messages, const int count, I2C_Interface *const *devices)
+{
+    std::chrono::microseconds backoff = policy.backoff;
+    int attempt = 0;
+    int error = 0;
+    bool ok;
+    while (!(ok = i2c_bus.TransferBatch(messages, count, devices)))
+    {
+        error = errno;
+        if ((attempt >= policy.retries) || !IsTransient(error))
+            break;
+        attempt++;
+        TRACE_INFO(addr, "batch errno {} - retry {} in {}us", error, attempt, backoff.count());
+        std::this_thread::sleep_for(backoff);
+        backoff *= 2;
+    }
+    if (!ok)
+    {
+        errno = error;
+    }
+    return ok;
+}
+
+/**
+ * @brief account the share of the device in a batched transfer of
+ *        several devices - counted like a transaction of its own
+ * 
+ * @param op operation of the messages to this device
+ * @param elapsed share of the transfer time
+ * @param ok result of the transfer
+ * @param length bytes to and from this device
+ */
+void I2C_Device::Account(I2C_Operation op, std::chrono::microseconds elapsed, bool ok, int length)
+{
+    Record(op, elapsed, ok, length);
+}
+
+/**
+ * @brief account one transaction - lock-free, may be called from any thread
+ * 
+ * @param op operation that was executed
+ * @param duration time of the transfer including retries
+ * @param ok result of the transfer
+ * @param length bytes of the transaction - only counted when it succeeded
+ */
+void I2C_Device::Record(I2C_Operation op, std::chrono::microseconds duration, bool ok, int length)
+{
+    unsigned long elapsed = duration.count();
+    OpCounters &op_counters = counters[op];
+
+    int bucket = 0;
+    while ((bucket < I2C_OpStats::Buckets - 1) && ((1UL << bucket) <= elapsed))
+        bucket++;
+
+    op_counters.count.fetch_add(1, std::memory_order_relaxed);
+    op_counters.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    op_counters.totalTime.fetch_add(elapsed, std::memory_order_relaxed);
+    if (ok)
+        op_counters.bytes.fetch_add(length, std::memory_order_relaxed);
+    else
+        op_counters.errors.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long max = op_counters.maxTime.load(std::memory_order_relaxed);
+    while ((elapsed > max) && !op_counters.maxTime.compare_exchange_weak(max, elapsed, std::memory_order_relaxed))
+        ;
+}
+
+/**
+ * @brief copy of the counters of one operation
+ *        the fields are read one by one - a transaction running in parallel
+ *        may be visible in some of them only
+ * 
+ * @param op operation
+ * @return I2C_OpStats 
+ */
+I2C_OpStats I2C_Device::GetStats(I2C_Operation op) const
+{
+    OpCounters const &op_counters = counters[op];
+    I2C_OpStats stats;
+    stats.count = op_counters.count.load(std::memory_order_relaxed);
+    stats.errors = op_counters.errors.load(std::memory_order_relaxed);
+    stats.retries = op_counters.retries.load(std::memory_order_relaxed);
+    stats.skipped = op_counters.skipped.load(std::memory_order_relaxed);
+    stats.bytes = op_counters.bytes.load(std::memory_order_relaxed);
+    stats.totalTime = std::chrono::microseconds(op_counters.totalTime.load(std::memory_order_relaxed));
+    stats.maxTime = std::chrono::microseconds(op_counters.maxTime.load(std::memory_order_relaxed));
+    for (int i = 0; i < I2C_OpStats::Buckets; i++)
+        stats.histogram[i] = op_counters.histogram[i].load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief clear all counters
+ * 
+ */
+void I2C_Device::ResetStats()
+{
+    for (OpCounters &op_counters : counters)
+    {
+        op_counters.count.store(0, std::memory_order_relaxed);
+        op_counters.errors.store(0, std::memory_order_relaxed);
+        op_counters.retries.store(0, std::memory_order_relaxed);
+        op_counters.skipped.store(0, std::memory_order_relaxed);
+        op_counters.bytes.store(0, std::memory_order_relaxed);
+        op_counters.totalTime.store(0, std::memory_order_relaxed);
+        op_counters.maxTime.store(0, std::memory_order_relaxed);
+        for (std::atomic<unsigned long> &bucket : op_counters.histogram)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief print one line per used operation and its non-empty histogram buckets
+ * 
+ * @param out stream to print to
+ */
+void I2C_Device::PrintStats(std::ostream &out) const
+{
+    static const char *const OperationName[I2C_NUM_OPERATIONS] = {"write", "read", "writeread"};
+
+    for (int op = 0; op < I2C_NUM_OPERATIONS; op++)
+    {
+        I2C_OpStats stats = GetStats(static_cast<I2C_Operation>(op));
+        if ((stats.count == 0) && (stats.skipped == 0))
+            continue;
+
+        out << "0x" << std::hex << std::setfill('0') << std::setw(2) << addr
+            << std::dec << std::setfill(' ') << " " << std::left << std::setw(10) << OperationName[op] << std::right
+            << " count=" << stats.count << " errors=" << stats.errors << " retries=" << stats.retries
+            << " skipped=" << stats.skipped << " bytes=" << stats.bytes
+            << " avg=" << ((stats.count != 0) ? stats.totalTime.count() / stats.count : 0) << "us"
+            << " p50<" << stats.Percentile(0.5).count() << "us"
+            << " p99<" << stats.Percentile(0.99).count() << "us"
+            << " max=" << stats.maxTime.count() << "us" << std::endl;
+
+        out << "     ";
+        for (int i = 0; i < I2C_OpStats::Buckets; i++)
+        {
+            if (stats.histogram[i] == 0)
+                continue;
+            if (i == I2C_OpStats::Buckets - 1)
+                out << " >=" << (1UL << (i - 1)) << "us:" << stats.histogram[i];
+            else
+                out << " <" << (1UL << i) << "us:" << stats.histogram[i];
+        }
+        out << std::endl;
+    }
+}
+
+/**
+ * @brief upper bound of the histogram bucket in which the given fraction
+ *        of all transactions is reached
+ * 
+ * @param fraction 0..1 (e.g. 0.99 for the 99th percentile)
+ * @return std::chrono::microseconds - maxTime for the last bucket
+ */
+std::chrono::microseconds I2C_OpStats::Percentile(double fraction) const
+{
+    unsigned long sum = 0;
+    for (int i = 0; i < Buckets - 1; i++)
+    {
+        sum += histogram[i];
+        if ((count != 0) && (sum >= fraction * count))
+            return std::chrono::microseconds(1UL << i);
+    }
+    return maxTime;
+}
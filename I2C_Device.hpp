@@ -12,24 +12,120 @@
 #pragma once
 
 #include "I2C_Interface.hpp"
+#include "I2C_Bus.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+/**
+ * @brief counters of one operation of a device
+ *        histogram[0] counts transactions below 1us, histogram[i] those
+ *        in [2^(i-1), 2^i) us - the last bucket everything slower
+ * 
+ */
+struct I2C_OpStats
+{
+    static const int Buckets = 20;
+
+    unsigned long count;
+    unsigned long errors;
+    unsigned long retries;
+    unsigned long skipped;
+    unsigned long bytes;
+    std::chrono::microseconds totalTime;
+    std::chrono::microseconds maxTime;
+    unsigned long histogram[Buckets];
+
+    // upper bound of the bucket holding the given fraction (0..1) of all transactions
+    std::chrono::microseconds Percentile(double fraction) const;
+};
+
+/**
+ * @brief handling of failed transactions
+ *        Transient errors (lost arbitration, timeout, bus busy, protocol
+ *        error) are retried after backoff, doubled for every attempt. A
+ *        missing acknowledge is not retried. After quarantineAfter failed
+ *        transactions in a row the device is skipped for quarantineTime;
+ *        the first transaction after that probes it again.
+ * 
+ */
+struct I2C_RetryPolicy
+{
+    int retries;
+    std::chrono::microseconds backoff;
+    int quarantineAfter;
+    std::chrono::milliseconds quarantineTime;
+};
 
 class I2C_Device : public I2C_Interface
 {
 public:
-    I2C_Device(int device_id, bool verb);
+    I2C_Device(I2C_Bus &i2c_bus, int device_id);
     ~I2C_Device();
 
     virtual bool WriteByte(unsigned char const *buffer, const int length);
     virtual bool ReadByte(unsigned char *buffer, const int length);
+    virtual bool WriteRead(unsigned char const *wbuffer, const int wlength,
+                           unsigned char *rbuffer, const int rlength);
+
+    virtual bool TransferBatch(I2C_Bus &i2c_bus, struct i2c_msg *messages, const int count, I2C_Interface *const *devices);
 
     virtual int getAddress(){return addr;}
-    virtual bool isVerbose(){return verbose;}
+    virtual bool isAvailable();
+    virtual void Account(I2C_Operation op, std::chrono::microseconds elapsed, bool ok, int length);
+    I2C_Bus &getBus(){return *bus;}
+
+    void SetRetryPolicy(I2C_RetryPolicy const &retryPolicy){policy = retryPolicy;}
+    I2C_RetryPolicy const &getRetryPolicy(){return policy;}
+    bool isQuarantined(){return !isAvailable();}
+    static const I2C_RetryPolicy DefaultRetryPolicy;
+
+    I2C_OpStats GetStats(I2C_Operation op) const;
+    void ResetStats();
+    void PrintStats(std::ostream &out) const;
+
 private:
-    bool verbose;
-    int file_i2c;
+    /**
+     * @brief live counters - updated without a lock by every transaction
+     * 
+     */
+    struct OpCounters
+    {
+        std::atomic<unsigned long> count;
+        std::atomic<unsigned long> errors;
+        std::atomic<unsigned long> retries;
+        std::atomic<unsigned long> skipped;
+        std::atomic<unsigned long> bytes;
+        std::atomic<unsigned long> totalTime;
+        std::atomic<unsigned long> maxTime;
+        std::atomic<unsigned long> histogram[I2C_OpStats::Buckets];
+    };
+
+    bool Execute(I2C_Operation op, struct i2c_msg *messages, const int count, const int length);
+    void Record(I2C_Operation op, std::chrono::microseconds elapsed, bool ok, int length);
+
+    /**
+     * @brief adapter the device is connected to - owns the file descriptor
+     * 
+     */
+    I2C_Bus *bus;
     /**
      * @brief i2c adress of the device
      * 
      */
     int addr;
-};
\ No newline at end of file
+    /**
+     * @brief latency, byte and error counters per operation
+     * 
+     */
+    OpCounters counters[I2C_NUM_OPERATIONS];
+    I2C_RetryPolicy policy;
+    /**
+     * @brief failed transactions in a row and end of the quarantine
+     *        (steady_clock ticks, 0 = not quarantined)
+     * 
+     */
+    std::atomic<int> failures;
+    std::atomic<long long> quarantinedUntil;
+};
@@ -11,15 +11,90 @@
 
 #pragma once
 
+#include "I2C_Buffer.hpp"
+
+#include <chrono>
+#include <functional>
+#include <future>
+
+class I2C_Bus;
+struct i2c_msg;
+
+enum I2C_Operation
+{
+    I2C_OP_WRITE = 0,
+    I2C_OP_READ,
+    I2C_OP_WRITEREAD,
+    I2C_NUM_OPERATIONS
+};
+
 class I2C_Interface
 {
 public:
+    typedef std::function<bool()> Transaction;
+    typedef std::function<void(bool)> Completion;
+
     I2C_Interface(){};
-    ~I2C_Interface(){};
+    virtual ~I2C_Interface(){};
 
     virtual bool WriteByte(unsigned char const *buffer, const int length) = 0;
     virtual bool ReadByte(unsigned char *buffer, const int length) = 0;
+    virtual bool WriteRead(unsigned char const *wbuffer, const int wlength,
+                           unsigned char *rbuffer, const int rlength) = 0;
+
+    // inline buffers - a read fills the buffer up to its size (see I2C_Buffer::resize)
+    template <int Capacity>
+    bool Write(I2C_Buffer<Capacity> const &buffer){return WriteByte(buffer.data(), buffer.size());}
+    template <int Capacity>
+    bool Read(I2C_Buffer<Capacity> &buffer){return ReadByte(buffer.data(), buffer.size());}
+    template <int WriteCapacity, int ReadCapacity>
+    bool WriteRead(I2C_Buffer<WriteCapacity> const &command, I2C_Buffer<ReadCapacity> &reply)
+    {
+        return WriteRead(command.data(), command.size(), reply.data(), reply.size());
+    }
+
+    /**
+     * @brief submit a transaction (any sequence of calls on this interface)
+     *        without waiting for it. The default executes it immediately;
+     *        scheduled devices hand it to the bus worker.
+     * 
+     * @return future delivering the result of the transaction
+     */
+    virtual std::future<bool> Submit(Transaction transaction)
+    {
+        std::promise<bool> result;
+        result.set_value(transaction());
+        return result.get_future();
+    }
+
+    /**
+     * @brief submit a transaction and call done with its result once it
+     *        completed (on the thread that executed it)
+     */
+    virtual void Submit(Transaction transaction, Completion done)
+    {
+        done(transaction());
+    }
+
+    /**
+     * @brief transfer messages to several devices in one I2C_RDWR (see
+     *        I2C_Bus::TransferBatch) as a transaction of this device - with
+     *        its retry policy and, on a scheduled bus, in its traffic class
+     */
+    virtual bool TransferBatch(I2C_Bus &bus, struct i2c_msg *messages, const int count, I2C_Interface *const *devices) = 0;
 
     virtual int getAddress() = 0;
-    virtual bool isVerbose() = 0;
+
+    /**
+     * @brief false while the device is known to be unreachable (e.g.
+     *        quarantined after repeated failures) - batched access skips it
+     */
+    virtual bool isAvailable(){return true;}
+
+    /**
+     * @brief account a transfer the device took part in without executing
+     *        it itself (batched access of several devices in one I2C_RDWR,
+     *        see I2C_Bus::TransferBatch). The default keeps no statistics.
+     */
+    virtual void Account(I2C_Operation, std::chrono::microseconds, bool, int){}
 };
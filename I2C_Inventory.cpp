@@ -0,0 +1,280 @@
+/**
+ * @file I2C_Inventory.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief discovery of the devices on the i2c adapters and a file cache
+ *        of the result
+ * @version 0.1
+ * @date 2019-06-14
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "I2C_Inventory.hpp"
+#include "ds1631.hpp"
+#include "PcfLcd.hpp"
+
+#define TRACE_COMPONENT "I2C_Inventory"
+#include "tracer.hpp"
+
+static const char *const TypeNames[I2C_NUM_TYPES] = {"unknown", "DS1631", "PCF8574", "PCF8574A"};
+
+// address range selectable by the A2..A0 pins of the DS1631
+static const int DS1631_FirstAddress = 0x48;
+static const int DS1631_LastAddress = 0x4F;
+
+/**
+ * @brief Construct a new empty inventory
+ *
+ */
+I2C_Inventory::I2C_Inventory() : transfers(0)
+{
+}
+
+/**
+ * @brief Destroy the inventory
+ *
+ */
+I2C_Inventory::~I2C_Inventory()
+{
+}
+
+/**
+ * @brief name of a device type as used in the cache file
+ *
+ * @param type device type
+ * @return char const*
+ */
+char const *I2C_Inventory::TypeName(I2C_DeviceType type)
+{
+    return ((type >= 0) && (type < I2C_NUM_TYPES)) ? TypeNames[type] : TypeNames[I2C_TYPE_UNKNOWN];
+}
+
+bool I2C_Inventory::Transfer(I2C_Bus &bus, struct i2c_msg *messages, const int count)
+{
+    transfers++;
+    return bus.Transfer(messages, count);
+}
+
+/**
+ * @brief address the device with a write of no data (SMBus quick write) -
+ *        no register or output of any device is changed by it
+ *
+ * @param bus adapter
+ * @param address address to probe
+ * @return true if the address was acknowledged
+ */
+bool I2C_Inventory::Probe(I2C_Bus &bus, int address)
+{
+    unsigned char none = 0;
+    struct i2c_msg message;
+    message.addr = address;
+    message.flags = 0;
+    message.len = 0;
+    message.buf = &none;
+    return Transfer(bus, &message, 1);
+}
+
+/**
+ * @brief tell the type of a responding device from its behaviour
+ *        DS1631: answers the config command and delivers temperature and
+ *                TH in the 12 bit left aligned format (low nibble 0)
+ *        PCF8574(A): has no register pointer - every byte read returns the
+ *                same port state
+ *        Only reads are issued; the pointer write of the DS1631 commands
+ *        does not change a register.
+ *
+ * @param bus adapter
+ * @param address acknowledged address
+ * @return I2C_DeviceType
+ */
+I2C_DeviceType I2C_Inventory::Identify(I2C_Bus &bus, int address)
+{
+    struct i2c_msg messages[2];
+    if ((address >= DS1631_FirstAddress) && (address <= DS1631_LastAddress))
+    {
+        static const unsigned char commands[3] = {DS1631_ACCESS_CONFIG, DS1631_READ_TEMPERATURE, DS1631_ACCESS_TH};
+        unsigned char buffer[2];
+        for (unsigned char command : commands)
+        {
+            int length = (command == DS1631_ACCESS_CONFIG) ? 1 : 2;
+            messages[0].addr = address;
+            messages[0].flags = 0;
+            messages[0].len = 1;
+            messages[0].buf = &command;
+            messages[1].addr = address;
+            messages[1].flags = I2C_M_RD;
+            messages[1].len = length;
+            messages[1].buf = buffer;
+            if (!Transfer(bus, messages, 2))
+                return I2C_TYPE_UNKNOWN;
+            if ((length == 2) && ((buffer[1] & 0x0F) != 0))
+                return I2C_TYPE_UNKNOWN;
+        }
+        return I2C_TYPE_DS1631;
+    }
+
+    unsigned char port[2];
+    messages[0].addr = address;
+    messages[0].flags = I2C_M_RD;
+    messages[0].len = 2;
+    messages[0].buf = port;
+    if (!Transfer(bus, messages, 1) || (port[0] != port[1]))
+        return I2C_TYPE_UNKNOWN;
+    return (address < PCF_Addr[8]) ? I2C_TYPE_PCF8574 : I2C_TYPE_PCF8574A;
+}
+
+/**
+ * @brief probe the DS1631 and PCF8574/PCF8574A address ranges of an
+ *        adapter; replaces all entries of this adapter
+ *
+ * @param bus adapter
+ * @return number of responding devices
+ */
+int I2C_Inventory::Scan(I2C_Bus &bus)
+{
+    std::string const &adapter = bus.getAdapter();
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&adapter](I2C_InventoryEntry const &entry) { return entry.adapter == adapter; }),
+                  entries.end());
+
+    std::vector<int> addresses;
+    for (int address = DS1631_FirstAddress; address <= DS1631_LastAddress; address++)
+        addresses.push_back(address);
+    addresses.insert(addresses.end(), PCF_Addr, PCF_Addr + 16);
+
+    int found = 0;
+    for (int address : addresses)
+    {
+        if (!Probe(bus, address))
+            continue;
+        I2C_DeviceType type = Identify(bus, address);
+        TRACE_INFO(address, "type {}", type);
+        entries.push_back(I2C_InventoryEntry{adapter, address, type});
+        found++;
+    }
+    if (found == 0)
+    {
+        // remember that the adapter was scanned
+        entries.push_back(I2C_InventoryEntry{adapter, -1, I2C_TYPE_UNKNOWN});
+    }
+    return found;
+}
+
+/**
+ * @brief true if the inventory holds the result of a scan of this adapter
+ *        (a scan without any device is stored as well)
+ *
+ */
+bool I2C_Inventory::hasAdapter(std::string const &adapter)
+{
+    for (I2C_InventoryEntry const &entry : entries)
+    {
+        if (entry.adapter == adapter)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief addresses of all devices of a type on an adapter
+ *
+ * @param adapter adapter
+ * @param type device type
+ * @return std::vector<int> addresses in ascending order
+ */
+std::vector<int> I2C_Inventory::Find(std::string const &adapter, I2C_DeviceType type)
+{
+    std::vector<int> addresses;
+    for (I2C_InventoryEntry const &entry : entries)
+    {
+        if ((entry.adapter == adapter) && (entry.address >= 0) && (entry.type == type))
+            addresses.push_back(entry.address);
+    }
+    std::sort(addresses.begin(), addresses.end());
+    return addresses;
+}
+
+/**
+ * @brief read the inventory cache - one "adapter address type" line per
+ *        device; an adapter without devices has the address -1
+ *
+ * @param file cache file
+ * @return false if the file does not exist
+ */
+bool I2C_Inventory::Load(std::string const &file)
+{
+    std::ifstream cache(file.c_str());
+    if (!cache)
+    {
+        return false;
+    }
+
+    entries.clear();
+    std::string line;
+    while (std::getline(cache, line))
+    {
+        if (line.empty() || (line[0] == '#'))
+            continue;
+
+        std::istringstream fields(line);
+        I2C_InventoryEntry entry;
+        std::string name;
+        if (!(fields >> entry.adapter >> std::hex >> entry.address >> name))
+        {
+            std::cout << "inventory " << file << ": invalid line '" << line << "'" << std::endl;
+            continue;
+        }
+        entry.type = I2C_TYPE_UNKNOWN;
+        for (int type = 0; type < I2C_NUM_TYPES; type++)
+        {
+            if (name == TypeNames[type])
+                entry.type = static_cast<I2C_DeviceType>(type);
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+/**
+ * @brief write the inventory cache
+ *
+ * @param file cache file
+ * @return false if the file could not be written
+ */
+bool I2C_Inventory::Save(std::string const &file)
+{
+    std::ofstream cache(file.c_str(), std::ios::trunc);
+    if (!cache)
+    {
+        std::cout << "Failed to write the inventory " << file << std::endl;
+        return false;
+    }
+    cache << "# i2c inventory - adapter address type" << std::endl;
+    Print(cache);
+    return cache.good();
+}
+
+/**
+ * @brief one "adapter address type" line per device
+ *
+ * @param out stream to print to
+ */
+void I2C_Inventory::Print(std::ostream &out)
+{
+    for (I2C_InventoryEntry const &entry : entries)
+    {
+        out << entry.adapter << " ";
+        if (entry.address < 0)
+            out << "-1";
+        else
+            out << "0x" << std::hex << std::setfill('0') << std::setw(2) << entry.address << std::dec << std::setfill(' ');
+        out << " " << TypeName(entry.type) << std::endl;
+    }
+}
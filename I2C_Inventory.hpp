@@ -0,0 +1,70 @@
+/**
+ * @file I2C_Inventory.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief discovery of the devices on the i2c adapters and a file cache
+ *        of the result
+ * @version 0.1
+ * @date 2019-06-14
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_Bus.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum I2C_DeviceType
+{
+    I2C_TYPE_UNKNOWN = 0, // acknowledges its address, behaves like none of the below
+    I2C_TYPE_DS1631,
+    I2C_TYPE_PCF8574,
+    I2C_TYPE_PCF8574A,
+    I2C_NUM_TYPES
+};
+
+/**
+ * @brief one responding address
+ *
+ */
+struct I2C_InventoryEntry
+{
+    std::string adapter;
+    int address;
+    I2C_DeviceType type;
+};
+
+class I2C_Inventory
+{
+public:
+    I2C_Inventory();
+    ~I2C_Inventory();
+
+    int Scan(I2C_Bus &bus);
+    bool Load(std::string const &file);
+    bool Save(std::string const &file);
+
+    bool hasAdapter(std::string const &adapter);
+    std::vector<int> Find(std::string const &adapter, I2C_DeviceType type);
+    std::vector<I2C_InventoryEntry> const &getEntries(){return entries;}
+    unsigned long getTransfers(){return transfers;}
+    void Print(std::ostream &out);
+
+    static char const *TypeName(I2C_DeviceType type);
+
+private:
+    bool Probe(I2C_Bus &bus, int address);
+    bool Transfer(I2C_Bus &bus, struct i2c_msg *messages, const int count);
+    I2C_DeviceType Identify(I2C_Bus &bus, int address);
+
+    std::vector<I2C_InventoryEntry> entries;
+    /**
+     * @brief bus transfers issued by Scan()
+     *
+     */
+    unsigned long transfers;
+};
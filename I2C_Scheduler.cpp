@@ -0,0 +1,387 @@
+/**
+ * @file I2C_Scheduler.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief Implementation of the i2c bus scheduler
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <iostream>
+#include <iomanip>
+
+#include "I2C_Scheduler.hpp"
+
+#define TRACE_COMPONENT "I2C_Scheduler"
+#include "tracer.hpp"
+
+static const char *const ClassName[I2C_NUM_CLASSES] = {"sensor", "display", "background"};
+
+/**
+ * @brief Construct a new scheduler and start its bus worker
+ * 
+ */
+I2C_Scheduler::I2C_Scheduler() : stopping(false), sequence(0)
+{
+    budget[I2C_CLASS_SENSOR] = std::chrono::milliseconds(5);
+    budget[I2C_CLASS_DISPLAY] = std::chrono::milliseconds(50);
+    budget[I2C_CLASS_BACKGROUND] = std::chrono::milliseconds(500);
+    for (int cls = 0; cls < I2C_NUM_CLASSES; cls++)
+    {
+        stats[cls] = I2C_ClassStats{0, 0, std::chrono::microseconds(0), std::chrono::microseconds(0)};
+    }
+    worker = std::thread(&I2C_Scheduler::Run, this);
+}
+
+/**
+ * @brief Destroy the scheduler - pending transactions are still executed
+ * 
+ */
+I2C_Scheduler::~I2C_Scheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    worker.join();
+}
+
+/**
+ * @brief set the default deadline budget of a traffic class
+ * 
+ * @param cls traffic class
+ * @param classBudget time a transaction of this class may wait in the queue
+ */
+void I2C_Scheduler::SetDeadline(I2C_Class cls, std::chrono::microseconds classBudget)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    budget[cls] = classBudget;
+}
+
+/**
+ * @brief default deadline of a new transaction of a traffic class
+ * 
+ * @param cls traffic class
+ * @return now + budget of the class
+ */
+I2C_Scheduler::Clock::time_point I2C_Scheduler::DefaultDeadline(I2C_Class cls)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return Clock::now() + budget[cls];
+}
+
+/**
+ * @brief queue a transaction with the default deadline of its class and
+ *        wait for its completion
+ * 
+ * @param cls traffic class
+ * @param transaction bus access to execute on the worker
+ * @return result of the transaction
+ */
+bool I2C_Scheduler::Execute(I2C_Class cls, std::function<bool()> transaction)
+{
+    return Execute(cls, DefaultDeadline(cls), std::move(transaction));
+}
+
+/**
+ * @brief queue a transaction and wait for its completion.
+ *        Transactions issued by a transaction already running on the
+ *        worker are executed directly (no re-queueing). The job is kept on
+ *        the stack of the caller - nothing is allocated as long as the
+ *        transaction fits into std::function (up to two pointers).
+ * 
+ * @param cls traffic class
+ * @param deadline latest time the transaction should be started
+ * @param transaction bus access to execute on the worker
+ * @return result of the transaction
+ */
+bool I2C_Scheduler::Execute(I2C_Class cls, Clock::time_point deadline, std::function<bool()> transaction)
+{
+    if (isWorkerThread())
+    {
+        return transaction();
+    }
+    Job job;
+    job.cls = cls;
+    job.deadline = deadline;
+    job.submitted = Clock::now();
+    job.transaction = std::move(transaction);
+    job.finished = false;
+    job.result = false;
+    Enqueue(&job);
+
+    std::unique_lock<std::mutex> guard(lock);
+    completed.wait(guard, [&job] { return job.finished; });
+    if (job.error)
+    {
+        std::rethrow_exception(job.error);
+    }
+    return job.result;
+}
+
+/**
+ * @brief queue a transaction with the default deadline of its class
+ *        without waiting for it
+ * 
+ * @param cls traffic class
+ * @param transaction bus access to execute on the worker
+ * @return future delivering the result of the transaction
+ */
+std::future<bool> I2C_Scheduler::Post(I2C_Class cls, std::function<bool()> transaction)
+{
+    return Post(cls, DefaultDeadline(cls), std::move(transaction));
+}
+
+/**
+ * @brief queue a transaction without waiting for it. Transactions of one
+ *        class are started in submission order.
+ *        Never wait for the returned future on the worker itself.
+ * 
+ * @param cls traffic class
+ * @param deadline latest time the transaction should be started
+ * @param transaction bus access to execute on the worker
+ * @return future delivering the result of the transaction
+ */
+std::future<bool> I2C_Scheduler::Post(I2C_Class cls, Clock::time_point deadline, std::function<bool()> transaction)
+{
+    std::unique_ptr<Job> job(new Job());
+    job->cls = cls;
+    job->deadline = deadline;
+    job->submitted = Clock::now();
+    job->transaction = std::move(transaction);
+    job->promise.reset(new std::promise<bool>());
+    std::future<bool> result = job->promise->get_future();
+    Enqueue(job.release());
+    return result;
+}
+
+/**
+ * @brief put a job into the queue and wake the worker
+ * 
+ * @param job posted job (owned by the queue) or job of a waiting caller
+ */
+void I2C_Scheduler::Enqueue(Job *job)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job->sequence = sequence++;
+        queue.push_back(job);
+    }
+    wakeup.notify_one();
+}
+
+/**
+ * @brief select the next transaction (lock must be held).
+ *        Overdue transactions are served earliest-deadline-first so no
+ *        class starves, otherwise the highest priority class wins and
+ *        ties are broken by deadline and submission order.
+ * 
+ * @return job to execute next
+ */
+I2C_Scheduler::Job *I2C_Scheduler::PickNext()
+{
+    Clock::time_point now = Clock::now();
+    std::vector<Job *>::iterator best = queue.begin();
+    for (std::vector<Job *>::iterator it = queue.begin() + 1; it != queue.end(); ++it)
+    {
+        bool itOverdue = (*it)->deadline < now;
+        bool bestOverdue = (*best)->deadline < now;
+        if (itOverdue != bestOverdue)
+        {
+            if (itOverdue)
+                best = it;
+            continue;
+        }
+        if (!itOverdue && ((*it)->cls != (*best)->cls))
+        {
+            if ((*it)->cls < (*best)->cls)
+                best = it;
+            continue;
+        }
+        if (((*it)->deadline < (*best)->deadline) ||
+            (((*it)->deadline == (*best)->deadline) && ((*it)->sequence < (*best)->sequence)))
+        {
+            best = it;
+        }
+    }
+    Job *job = *best;
+    queue.erase(best);
+    return job;
+}
+
+/**
+ * @brief bus worker - executes one transaction at a time
+ * 
+ */
+void I2C_Scheduler::Run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        wakeup.wait(guard, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+        {
+            return; // stopping and drained
+        }
+
+        Job *job = PickNext();
+        Clock::time_point started = Clock::now();
+        std::chrono::microseconds delay = std::chrono::duration_cast<std::chrono::microseconds>(started - job->submitted);
+        I2C_ClassStats &classStats = stats[job->cls];
+        classStats.transactions++;
+        classStats.totalDelay += delay;
+        if (delay > classStats.maxDelay)
+            classStats.maxDelay = delay;
+        if (started > job->deadline)
+            classStats.missedDeadlines++;
+
+        TRACE_DEBUG(TRACE_NO_ADDRESS, "class {} waited {}us", job->cls, delay.count());
+
+        guard.unlock();
+        bool result = false;
+        std::exception_ptr error;
+        try
+        {
+            result = job->transaction();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        if (job->promise)
+        {
+            if (error)
+                job->promise->set_exception(error);
+            else
+                job->promise->set_value(result);
+            delete job;
+            guard.lock();
+        }
+        else
+        {
+            // the caller owns the job - it may be gone once finished is seen
+            guard.lock();
+            job->result = result;
+            job->error = error;
+            job->finished = true;
+            completed.notify_all();
+        }
+    }
+}
+
+/**
+ * @brief queueing delay statistics of a traffic class
+ * 
+ * @param cls traffic class
+ * @return copy of the current statistics
+ */
+I2C_ClassStats I2C_Scheduler::GetStats(I2C_Class cls)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stats[cls];
+}
+
+/**
+ * @brief print the queueing delay of all traffic classes
+ * 
+ * @param out stream to print to
+ */
+void I2C_Scheduler::PrintStats(std::ostream &out)
+{
+    for (int cls = 0; cls < I2C_NUM_CLASSES; cls++)
+    {
+        I2C_ClassStats classStats = GetStats(static_cast<I2C_Class>(cls));
+        long mean = classStats.transactions ? classStats.totalDelay.count() / (long)classStats.transactions : 0;
+        out << std::dec << std::setfill(' ') << std::setw(10) << ClassName[cls]
+            << ": transactions=" << classStats.transactions
+            << " delay mean=" << mean << "us max=" << classStats.maxDelay.count() << "us"
+            << " missed deadlines=" << classStats.missedDeadlines << std::endl;
+    }
+}
+
+/**
+ * @brief Construct a new scheduled device
+ * 
+ * @param sched scheduler of the bus the device is connected to
+ * @param target device executing the transactions
+ * @param cls traffic class of all transactions of this device
+ */
+I2C_ScheduledDevice::I2C_ScheduledDevice(I2C_Scheduler &sched, I2C_Interface &target, I2C_Class cls)
+    : scheduler(&sched), device(&target), trafficClass(cls)
+{
+}
+
+/**
+ * @brief Destroy the scheduled device
+ * 
+ */
+I2C_ScheduledDevice::~I2C_ScheduledDevice()
+{
+}
+
+// the synchronous calls wait for their transaction, so it refers to the
+// arguments on the stack of the caller - a single captured pointer is
+// stored inside std::function and the call does not touch the heap
+bool I2C_ScheduledDevice::WriteByte(unsigned char const *buffer, const int length)
+{
+    struct {I2C_Interface *target; unsigned char const *buffer; int length;} call = {device, buffer, length};
+    return scheduler->Execute(trafficClass, [&call] { return call.target->WriteByte(call.buffer, call.length); });
+}
+
+bool I2C_ScheduledDevice::ReadByte(unsigned char *buffer, const int length)
+{
+    struct {I2C_Interface *target; unsigned char *buffer; int length;} call = {device, buffer, length};
+    return scheduler->Execute(trafficClass, [&call] { return call.target->ReadByte(call.buffer, call.length); });
+}
+
+bool I2C_ScheduledDevice::WriteRead(unsigned char const *wbuffer, const int wlength,
+                                    unsigned char *rbuffer, const int rlength)
+{
+    struct {I2C_Interface *target; unsigned char const *wbuffer; int wlength; unsigned char *rbuffer; int rlength;} call =
+        {device, wbuffer, wlength, rbuffer, rlength};
+    return scheduler->Execute(trafficClass, [&call] { return call.target->WriteRead(call.wbuffer, call.wlength, call.rbuffer, call.rlength); });
+}
+
+/**
+ * @brief queue a batch of several devices in the traffic class of this
+ *        device and wait for it - the retry policy of the underlying
+ *        device applies
+ */
+bool I2C_ScheduledDevice::TransferBatch(I2C_Bus &bus, struct i2c_msg *messages, const int count, I2C_Interface *const *devices)
+{
+    struct {I2C_Interface *target; I2C_Bus *bus; struct i2c_msg *messages; int count; I2C_Interface *const *devices;} call =
+        {device, &bus, messages, count, devices};
+    return scheduler->Execute(trafficClass, [&call] {
+        return call.target->TransferBatch(*call.bus, call.messages, call.count, call.devices);
+    });
+}
+
+/**
+ * @brief queue a transaction on the bus worker without waiting for it
+ * 
+ * @param transaction calls on the underlying device
+ * @return future delivering the result of the transaction
+ */
+std::future<bool> I2C_ScheduledDevice::Submit(Transaction transaction)
+{
+    return scheduler->Post(trafficClass, transaction);
+}
+
+/**
+ * @brief queue a transaction on the bus worker; done is called on the
+ *        worker once the transaction completed
+ * 
+ * @param transaction calls on the underlying device
+ * @param done completion callback receiving the result
+ */
+void I2C_ScheduledDevice::Submit(Transaction transaction, Completion done)
+{
+    scheduler->Post(trafficClass, [transaction, done] {
+        bool result = transaction();
+        done(result);
+        return result;
+    });
+}
@@ -0,0 +1,143 @@
+/**
+ * @file I2C_Scheduler.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief priority/deadline scheduler for transactions sharing one i2c bus
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_Interface.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief traffic classes - a lower value is served first
+ * 
+ */
+enum I2C_Class
+{
+    I2C_CLASS_SENSOR = 0,  // time critical sensor reads
+    I2C_CLASS_DISPLAY,     // display refresh
+    I2C_CLASS_BACKGROUND,  // bulk / maintenance traffic
+    I2C_NUM_CLASSES
+};
+
+/**
+ * @brief queueing delay of one traffic class
+ * 
+ */
+struct I2C_ClassStats
+{
+    unsigned long transactions;
+    unsigned long missedDeadlines;
+    std::chrono::microseconds totalDelay;
+    std::chrono::microseconds maxDelay;
+};
+
+class I2C_Scheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    I2C_Scheduler();
+    ~I2C_Scheduler();
+
+    I2C_Scheduler(I2C_Scheduler const &) = delete;
+    I2C_Scheduler &operator=(I2C_Scheduler const &) = delete;
+
+    bool Execute(I2C_Class cls, std::function<bool()> transaction);
+    bool Execute(I2C_Class cls, Clock::time_point deadline, std::function<bool()> transaction);
+
+    std::future<bool> Post(I2C_Class cls, std::function<bool()> transaction);
+    std::future<bool> Post(I2C_Class cls, Clock::time_point deadline, std::function<bool()> transaction);
+
+    void SetDeadline(I2C_Class cls, std::chrono::microseconds budget);
+    I2C_ClassStats GetStats(I2C_Class cls);
+    void PrintStats(std::ostream &out);
+
+    bool isWorkerThread(){return std::this_thread::get_id() == worker.get_id();}
+
+private:
+    /**
+     * @brief queued transaction. Posted jobs are owned by the queue and
+     *        deliver their result through the promise; a job of Execute()
+     *        lives on the stack of the waiting caller, so a synchronous
+     *        transaction does not touch the heap.
+     *
+     */
+    struct Job
+    {
+        I2C_Class cls;
+        Clock::time_point deadline;
+        Clock::time_point submitted;
+        unsigned long sequence;
+        std::function<bool()> transaction;
+        std::unique_ptr<std::promise<bool> > promise;
+        bool finished;
+        bool result;
+        std::exception_ptr error;
+    };
+
+    void Run();
+    void Enqueue(Job *job);
+    Job *PickNext();
+    Clock::time_point DefaultDeadline(I2C_Class cls);
+
+    bool stopping;
+    unsigned long sequence;
+    std::chrono::microseconds budget[I2C_NUM_CLASSES];
+    I2C_ClassStats stats[I2C_NUM_CLASSES];
+    std::vector<Job *> queue;
+    std::mutex lock;
+    std::condition_variable wakeup;
+    std::condition_variable completed; // a job of Execute() finished
+    std::thread worker;
+};
+
+/**
+ * @brief i2c device handle whose transactions are queued in a scheduler
+ * 
+ */
+class I2C_ScheduledDevice : public I2C_Interface
+{
+public:
+    I2C_ScheduledDevice(I2C_Scheduler &sched, I2C_Interface &target, I2C_Class cls);
+    ~I2C_ScheduledDevice();
+
+    virtual bool WriteByte(unsigned char const *buffer, const int length);
+    virtual bool ReadByte(unsigned char *buffer, const int length);
+    virtual bool WriteRead(unsigned char const *wbuffer, const int wlength,
+                           unsigned char *rbuffer, const int rlength);
+
+    virtual std::future<bool> Submit(Transaction transaction);
+    virtual void Submit(Transaction transaction, Completion done);
+
+    virtual bool TransferBatch(I2C_Bus &bus, struct i2c_msg *messages, const int count, I2C_Interface *const *devices);
+
+    virtual int getAddress(){return device->getAddress();}
+    virtual bool isAvailable(){return device->isAvailable();}
+    virtual void Account(I2C_Operation op, std::chrono::microseconds elapsed, bool ok, int length)
+    {
+        device->Account(op, elapsed, ok, length);
+    }
+    I2C_Class getClass(){return trafficClass;}
+
+private:
+    I2C_Scheduler *scheduler;
+    I2C_Interface *device;
+    I2C_Class trafficClass;
+};
@@ -0,0 +1,204 @@
+/**
+ * @file I2C_SimBus.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief Implementation of the simulated i2c adapter
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <cerrno>
+#include <thread>
+
+#include "I2C_SimBus.hpp"
+
+#define TRACE_COMPONENT "I2C_SimBus"
+#include "tracer.hpp"
+
+/**
+ * @brief Construct a new simulated bus.
+ *        Default timing is a 100kHz bus: 9 clocks per byte plus START/STOP.
+ * 
+ * @param name name of the bus used in traces
+ */
+I2C_SimBus::I2C_SimBus(std::string const &name)
+    : I2C_Bus(name, false),
+      transferLatency(std::chrono::microseconds(20)),
+      byteLatency(std::chrono::microseconds(90)),
+      faultRate(0),
+      random(1)
+{
+    ResetStats();
+}
+
+/**
+ * @brief Destroy the simulated bus - attached models are not owned
+ * 
+ */
+I2C_SimBus::~I2C_SimBus()
+{
+}
+
+/**
+ * @brief connect a device model to the bus
+ * 
+ * @param address 7 bit slave address
+ * @param device model answering on this address (not owned)
+ */
+void I2C_SimBus::Attach(int address, I2C_SimDevice *device)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    devices[address] = device;
+}
+
+/**
+ * @brief disconnect a device model (e.g. to simulate an unplugged sensor)
+ * 
+ * @param address 7 bit slave address
+ */
+void I2C_SimBus::Detach(int address)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    devices.erase(address);
+}
+
+/**
+ * @brief set the time a transfer occupies the bus
+ * 
+ * @param perTransfer fixed cost of one I2C_RDWR (syscall, START/STOP)
+ * @param perByte cost of every address and data byte
+ */
+void I2C_SimBus::SetLatency(std::chrono::microseconds perTransfer, std::chrono::microseconds perByte)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    transferLatency = perTransfer;
+    byteLatency = perByte;
+}
+
+/**
+ * @brief let the next transfers to an address fail with a NACK (ENXIO) -
+ *        not retried by I2C_Device, counts towards its quarantine
+ * 
+ * @param address 7 bit slave address
+ * @param transfers number of transfers to fail
+ */
+void I2C_SimBus::FailNext(int address, int transfers)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    pendingFaults[address] += transfers;
+}
+
+/**
+ * @brief let every message fail with the given probability - a transient
+ *        bus error (EIO) which I2C_Device retries
+ * 
+ * @param probability 0.0 .. 1.0
+ * @param seed seed of the fault generator - same seed, same faults
+ */
+void I2C_SimBus::SetFaultRate(double probability, unsigned int seed)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    faultRate = probability;
+    random.seed(seed);
+}
+
+/**
+ * @brief counters since construction or the last ResetStats()
+ * 
+ * @return copy of the counters
+ */
+I2C_SimStats I2C_SimBus::GetStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return stats;
+}
+
+void I2C_SimBus::ResetStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    stats = I2C_SimStats{0, 0, 0, 0, std::chrono::microseconds(0)};
+}
+
+/**
+ * @brief execute the messages on the attached models.
+ *        Like the kernel, the transfer stops at the first NACK and sets
+ *        errno: ENXIO for a missing or refusing slave and a NACK injected
+ *        by FailNext(), EIO for a random fault of SetFaultRate().
+ * 
+ * @param messages messages to transfer (addr, flags, len, buf)
+ * @param count number of messages
+ * @return true if all messages were transferred
+ */
+bool I2C_SimBus::Transfer(struct i2c_msg *messages, const int count)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} messages", count);
+
+    if ((count <= 0) || (count > MaxMessages))
+    {
+        TRACE_ERROR(TRACE_NO_ADDRESS, "invalid number of messages {}", count);
+        errno = EINVAL;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> occupied(busy);
+    std::chrono::microseconds duration;
+    bool ret = true;
+    int error = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        duration = transferLatency;
+        stats.transfers++;
+        for (int i = 0; i < count; i++)
+        {
+            struct i2c_msg &message = messages[i];
+            stats.messages++;
+            duration += byteLatency; // address byte
+
+            std::map<int, I2C_SimDevice *>::iterator device = devices.find(message.addr);
+            std::map<int, int>::iterator fault = pendingFaults.find(message.addr);
+            bool nacked = false;
+            bool garbled = false;
+            if ((fault != pendingFaults.end()) && (fault->second > 0))
+            {
+                nacked = true;
+                if (--fault->second == 0)
+                    pendingFaults.erase(fault);
+            }
+            else if ((faultRate > 0) && (std::uniform_real_distribution<double>(0, 1)(random) < faultRate))
+            {
+                garbled = true;
+            }
+
+            bool ack = !nacked && !garbled && (device != devices.end());
+            if (ack)
+            {
+                if (message.flags & I2C_M_RD)
+                    ack = device->second->Read(message.buf, message.len);
+                else
+                    ack = device->second->Write(message.buf, message.len);
+            }
+            if (!ack)
+            {
+                stats.nacks++;
+                error = garbled ? EIO : ENXIO;
+                ret = false;
+                break;
+            }
+            duration += byteLatency * message.len;
+            stats.bytes += message.len;
+        }
+        stats.busTime += duration;
+    }
+
+    if (duration.count() > 0)
+    {
+        std::this_thread::sleep_for(duration);
+    }
+    if (!ret)
+    {
+        errno = error;
+    }
+    return ret;
+}
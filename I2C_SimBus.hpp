@@ -0,0 +1,77 @@
+/**
+ * @file I2C_SimBus.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief simulated i2c adapter with device models - no hardware needed
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_Bus.hpp"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+
+/**
+ * @brief model of a slave on the simulated bus
+ * 
+ */
+class I2C_SimDevice
+{
+public:
+    I2C_SimDevice(){};
+    virtual ~I2C_SimDevice(){};
+
+    // called once per message - return false to NACK
+    virtual bool Write(unsigned char const *buffer, const int length) = 0;
+    virtual bool Read(unsigned char *buffer, const int length) = 0;
+};
+
+/**
+ * @brief counters of the simulated bus
+ * 
+ */
+struct I2C_SimStats
+{
+    unsigned long transfers;
+    unsigned long messages;
+    unsigned long bytes;
+    unsigned long nacks;
+    std::chrono::microseconds busTime;
+};
+
+class I2C_SimBus : public I2C_Bus
+{
+public:
+    I2C_SimBus(std::string const &name);
+    ~I2C_SimBus();
+
+    virtual bool Transfer(struct i2c_msg *messages, const int count);
+
+    void Attach(int address, I2C_SimDevice *device);
+    void Detach(int address);
+
+    void SetLatency(std::chrono::microseconds perTransfer, std::chrono::microseconds perByte);
+    void FailNext(int address, int transfers);
+    void SetFaultRate(double probability, unsigned int seed = 1);
+
+    I2C_SimStats GetStats();
+    void ResetStats();
+
+private:
+    std::mutex busy; // held for the whole transfer - the bus is a shared medium
+    std::mutex lock; // protects models, faults and counters
+    std::map<int, I2C_SimDevice *> devices;
+    std::map<int, int> pendingFaults;
+    std::chrono::microseconds transferLatency;
+    std::chrono::microseconds byteLatency;
+    double faultRate;
+    std::mt19937 random;
+    I2C_SimStats stats;
+};
@@ -31,15 +31,17 @@
 
 #include "PcfLcd.hpp"
 
+#define TRACE_COMPONENT "PcfLcd"
+#include "tracer.hpp"
+
 #include <thread>
 #include <chrono>
 #include <ctime>
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
 #include <cmath>
-#include <iomanip>
-#include <sstream>
-#include <algorithm>
+#include <locale.h>
 
 // PCF_LCD ASCII Codes
 #define PCF_LCD_AE  0
@@ -130,16 +132,22 @@ const short DESIGN_UE[] = {10, 00, 17, 17, 17, 17, 14, 00};
 const short DESIGN_SZ[] = {00, 00, 14, 17, 30, 17, 30, 16};
 #define ASCII_SZ   0x04
 
-PcfLcd::PcfLcd(I2C_Device *i2c_dev, short PcfNr, bool backlight) : i2c_device(i2c_dev)
+PcfLcd::PcfLcd(I2C_Interface *i2c_dev, short PcfNr, bool backlight) : i2c_device(i2c_dev)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
 //  SetPcf(PcfNr);
   SetLight(backlight);
   init();
 }
 
+/*************************************/
+/* Kopie - teilt das i2c-Device      */
+/*************************************/
+PcfLcd::PcfLcd(PcfLcd const &other) : i2c_device(other.i2c_device), lightState(other.lightState.load())
+{
+}
+
 PcfLcd ::~PcfLcd()
 {
 
@@ -150,8 +158,7 @@ PcfLcd ::~PcfLcd()
 /*************************************/
 void PcfLcd::SetLight(bool state)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " <<  state << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", state);
 
   if(state)
   {
@@ -161,8 +168,9 @@ void PcfLcd::SetLight(bool state)
   {
     lightState = PCF_LCD_LIGHT_OFF;
   }
-  AddByteToBuffer(lightState, true);
-  SendBuffer();
+  I2C_Buffer<1> out;
+  AddByte(out, 0);
+  i2c_device->Write(out);
 }
 
 /*************************************/
@@ -170,8 +178,7 @@ void PcfLcd::SetLight(bool state)
 /*************************************/
 void PcfLcd::init()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   // sequence see LCD204B#DIS.pdf "Initializing by Instruction"
   // https://www.mikrocontroller.net/articles/AVR-Tutorial:_LCD#Initialisierung_f.C3.BCr_4_Bit_Modus
@@ -219,7 +226,7 @@ short PcfLcd::AddByteToBuffer(short byte, bool clearbuffer)
    {
       buffer.clear();
    }
-  buffer.push_back(byte | lightState);
+  return buffer.push_back(byte | lightState);
 }
 
 /*************************************/
@@ -228,7 +235,7 @@ short PcfLcd::AddByteToBuffer(short byte, bool clearbuffer)
 /*************************************/
 bool PcfLcd::SendBuffer()
 {
-  i2c_device->WriteByte(buffer.data(), buffer.size());
+  return i2c_device->Write(buffer);
 }
 
 /*************************************/
@@ -237,8 +244,7 @@ bool PcfLcd::SendBuffer()
 /*************************************/
 void PcfLcd::WriteCmd (short const cmd, bool const fourBitMode)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << cmd << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", cmd);
 
   short _cmd_LowNibble =  (cmd & 0x0F);
   short _cmd_HighNibble = (cmd & 0xF0) >> 4;
@@ -259,8 +265,7 @@ void PcfLcd::WriteCmd (short const cmd, bool const fourBitMode)
 /*************************************/
 void PcfLcd::WriteData (short const cmd)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << cmd << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", cmd);
 
   short _cmd_LowNibble =  (cmd & 0x0F);
   short _cmd_HighNibble = (cmd & 0xF0) >> 4;
@@ -274,8 +279,7 @@ void PcfLcd::WriteData (short const cmd)
 /*************************************/
 void PcfLcd::WriteOut (short const cmd, bool const RegisterSelect)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << cmd << " - RegisterSelect=" << RegisterSelect<< std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{x} - RegisterSelect={}", cmd, RegisterSelect);
 
   short ctrl = 0;
   if (RegisterSelect == PCF_LCD_SEND_COMMAND)
@@ -289,14 +293,16 @@ void PcfLcd::WriteOut (short const cmd, bool const RegisterSelect)
   
   short _cmd = cmd << 4; // shift left as datalines are bit4..bit7
 
+  // local stream - output may run on the caller thread and the bus worker at once
+  I2C_Buffer<3> out;
   // set ENABLE to ACTIVE
-  AddByteToBuffer(PCF_LCD_ENABLE_ON  | ctrl, true);
+  AddByte(out, PCF_LCD_ENABLE_ON  | ctrl);
   // send DATA with ENABLE=ACTIVE
-  AddByteToBuffer(PCF_LCD_ENABLE_ON  | ctrl | _cmd);
+  AddByte(out, PCF_LCD_ENABLE_ON  | ctrl | _cmd);
   // use data by setting ENABLE=OFF
-  AddByteToBuffer(PCF_LCD_ENABLE_OFF | ctrl | _cmd);
+  AddByte(out, PCF_LCD_ENABLE_OFF | ctrl | _cmd);
   
-  SendBuffer();
+  i2c_device->Write(out);
 }
 
 /*************************************/
@@ -308,28 +314,27 @@ void PcfLcd::WriteOut (short const cmd, bool const RegisterSelect)
 /*************************************/
 short PcfLcd::ReadRam()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   unsigned char _buffer[1];
   short data;
-  AddByteToBuffer(0xF3, true);
-  AddByteToBuffer(0xF7);
-  SendBuffer();
+  I2C_Buffer<2> out;
+  AddByte(out, 0xF3);
+  AddByte(out, 0xF7);
+  i2c_device->Write(out);
 
   i2c_device->ReadByte(_buffer, 1);
   data = _buffer[0] && 0xF0; // High-Nibble
 
-  AddByteToBuffer(0xF3, true);
-  AddByteToBuffer(0xF7);
-  SendBuffer();
+  i2c_device->Write(out);
 
   i2c_device->ReadByte(_buffer, 1);
   data = data || (_buffer[0] > 4); // Low-Nibble
 
-  AddByteToBuffer(0xF3, true);
-  AddByteToBuffer(0xF0);
-  SendBuffer();
+  out.clear();
+  AddByte(out, 0xF3);
+  AddByte(out, 0xF0);
+  i2c_device->Write(out);
   return data;
 }
 
@@ -343,31 +348,31 @@ short PcfLcd::ReadRam()
 /*************************************/
 void PcfLcd::defineChar(short addr, short character[8])
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short i;
+  I2C_Buffer<BufferSize> out;
   addr = ((addr && 0x7) < 3) || 0x40;
-  AddByteToBuffer(0x04, true);
-  AddByteToBuffer(0x00);
-  AddByteToBuffer(0x64);
-  AddByteToBuffer(0x60);
-  AddByteToBuffer((addr && 0xF0) || 0x4); // HighNibble
-  AddByteToBuffer((addr && 0xF0));
-  AddByteToBuffer((addr < 4) || 0x4); // LowNibble
-  AddByteToBuffer((addr < 4));
+  AddByte(out, 0x04);
+  AddByte(out, 0x00);
+  AddByte(out, 0x64);
+  AddByte(out, 0x60);
+  AddByte(out, (addr && 0xF0) || 0x4); // HighNibble
+  AddByte(out, (addr && 0xF0));
+  AddByte(out, (addr < 4) || 0x4); // LowNibble
+  AddByte(out, (addr < 4));
   for (i = 0; i < 7; i++)
   {
-    AddByteToBuffer((character[i] && 0xF0) || 0x5); // HighNibble
-    AddByteToBuffer((character[i] && 0xF0) || 0x1);
-    AddByteToBuffer((character[i] < 4) || 0x5); // LowNibble
-    AddByteToBuffer((character[i] < 4) || 0x1);
+    AddByte(out, (character[i] && 0xF0) || 0x5); // HighNibble
+    AddByte(out, (character[i] && 0xF0) || 0x1);
+    AddByte(out, (character[i] < 4) || 0x5); // LowNibble
+    AddByte(out, (character[i] < 4) || 0x1);
   }
-  AddByteToBuffer(0x84);
-  AddByteToBuffer(0x80);
-  AddByteToBuffer(0x04);
-  AddByteToBuffer(0x00);
-  SendBuffer();
+  AddByte(out, 0x84);
+  AddByte(out, 0x80);
+  AddByte(out, 0x04);
+  AddByte(out, 0x00);
+  i2c_device->Write(out);
 }
 
 /*************************************/
@@ -375,8 +380,7 @@ void PcfLcd::defineChar(short addr, short character[8])
 /*************************************/
 void PcfLcd::defineGermanChars()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short ae[8], oe[8], ue[8], sz[8];
   short i;
@@ -400,8 +404,7 @@ void PcfLcd::defineGermanChars()
 /*************************************/
 void PcfLcd::clear()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   WriteCmd(PCF_LCD_CLEAR_DISPLAY );
   std::this_thread::sleep_for(std::chrono::milliseconds(2));
@@ -412,8 +415,7 @@ void PcfLcd::clear()
 /*************************************/
 void PcfLcd::home()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   WriteCmd(PCF_LCD_CURSOR_HOME );
   std::this_thread::sleep_for(std::chrono::milliseconds(2));
@@ -424,8 +426,7 @@ void PcfLcd::home()
 /***********************************/
 void PcfLcd::delline(short const LineNr)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << LineNr << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", LineNr);
 
   short i;
   line(LineNr);
@@ -433,7 +434,6 @@ void PcfLcd::delline(short const LineNr)
   {
     put(' ');
   }
-  SendBuffer();
 }
 
 /***********************************/
@@ -442,8 +442,7 @@ void PcfLcd::delline(short const LineNr)
 /***********************************/
 void PcfLcd::line(short const LineNr)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") -- " << LineNr << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", LineNr);
 
   gotopos(LineNr, 0);
 }
@@ -454,8 +453,7 @@ void PcfLcd::line(short const LineNr)
 /***********************************/
 void PcfLcd::gotopos(short const LineNr, short const Col)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << LineNr << ":" << Col << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}:{}", LineNr, Col);
 
   if( (LineNr < NumerOfLines) && (Col < CharsPerLine) )
   {
@@ -469,14 +467,14 @@ void PcfLcd::gotopos(short const LineNr, short const Col)
 /***********************************/
 void PcfLcd::cursorleft()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
-    AddByteToBuffer(0x14, true); // HighNibble
-    AddByteToBuffer(0x10);
-    AddByteToBuffer(0x04); // LowNibble
-    AddByteToBuffer(0x00);
-    SendBuffer();
+    I2C_Buffer<4> out;
+    AddByte(out, 0x14); // HighNibble
+    AddByte(out, 0x10);
+    AddByte(out, 0x04); // LowNibble
+    AddByte(out, 0x00);
+    i2c_device->Write(out);
 }
 
 /***********************************/
@@ -484,14 +482,14 @@ void PcfLcd::cursorleft()
 /***********************************/
 void PcfLcd::cursorright()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
-  AddByteToBuffer(0x14, true); // HighNibble
-  AddByteToBuffer(0x10);
-  AddByteToBuffer(0x44); // LowNibble
-  AddByteToBuffer(0x40);
-  SendBuffer();
+  I2C_Buffer<4> out;
+  AddByte(out, 0x14); // HighNibble
+  AddByte(out, 0x10);
+  AddByte(out, 0x44); // LowNibble
+  AddByte(out, 0x40);
+  i2c_device->Write(out);
 }
 
 /***********************************/
@@ -501,8 +499,7 @@ void PcfLcd::cursorright()
 /***********************************/
 void PcfLcd::setcursor(short cursor)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   WriteCmd((cursor && 0x3) || 0x0C);
 }
@@ -513,8 +510,7 @@ void PcfLcd::setcursor(short cursor)
 /*************************************/
 void PcfLcd::put(short character)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << (char)character << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{x}", character);
 
   WriteData(character);
 }
@@ -523,10 +519,19 @@ void PcfLcd::put(short character)
 /* Ausgabe einer Stringvariable      */
 /* auf das LCD                       */
 /*************************************/
-void PcfLcd::print2(std::string text)
+void PcfLcd::print2(char const *text)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << text << " -"<< std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
+
+  for (; *text != '\0'; text++)
+  {
+    put(*text);
+  }
+}
+
+void PcfLcd::print2(std::string const &text)
+{
+  TRACE_BYTES_DEBUG(i2c_device->getAddress(), (unsigned char const *)text.data(), text.size());
 
   for (auto character:text)
   {
@@ -538,10 +543,9 @@ void PcfLcd::print2(std::string text)
 /* Ausgabe eines Strings             */
 /* auf das LCD                       */
 /*************************************/
-void PcfLcd::print(std::string s)
+void PcfLcd::print(std::string const &s)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   print2(s);
 }
@@ -552,8 +556,7 @@ void PcfLcd::print(std::string s)
 /*************************************/
 void PcfLcd::printlength(short s[], short len)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short i;
   for (i = 0; i < (len - 1); i++)
@@ -562,6 +565,35 @@ void PcfLcd::printlength(short s[], short len)
   }
 }
 
+/*************************************/
+/* Ausgabe einer Stringvariable      */
+/* ohne auf den Bus zu warten.       */
+/* Der ganze Text ist ein Job        */
+/*************************************/
+std::future<bool> PcfLcd::print2Async(std::string text)
+{
+  TRACE_BYTES_DEBUG(i2c_device->getAddress(), (unsigned char const *)text.data(), text.size());
+
+  return i2c_device->Submit([this, text] {
+    print2(text);
+    return true;
+  });
+}
+
+/*************************************/
+/* beliebige Ausgabe (z.B. Zeile     */
+/* aufbauen) als ein Job ausführen   */
+/*************************************/
+std::future<bool> PcfLcd::updateAsync(std::function<void(PcfLcd &)> update)
+{
+  TRACE_DEBUG(i2c_device->getAddress(), "");
+
+  return i2c_device->Submit([this, update] {
+    update(*this);
+    return true;
+  });
+}
+
 /*************************************/
 /* Zahlausgaben                      */
 /*************************************/
@@ -571,8 +603,7 @@ void PcfLcd::printlength(short s[], short len)
 /*************************************/
 void PcfLcd::ziff(short num)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << num << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", num);
 
   put('0' + num);
 }
@@ -582,11 +613,10 @@ void PcfLcd::ziff(short num)
 /*************************************/
 void PcfLcd::zahl(int num)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << num << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{}", num);
 
-  std::string Number = std::to_string(num);
-  
+  char Number[12]; // -2147483648
+  std::snprintf(Number, sizeof(Number), "%d", num);
   print2(Number);
 }
 
@@ -595,15 +625,15 @@ void PcfLcd::zahl(int num)
 /*************************************/
 void PcfLcd::zahl(float num, short precision)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ") - " << num << " - " << precision << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "{} - {}", num, precision);
 
-  std::string Number = std::to_string((int)num);
+  char Number[12];
+  std::snprintf(Number, sizeof(Number), "%d", (int)num);
   print2(Number);
   put('.');
   float f3;
   float f2 = std::modf(num, &f3);
-  Number = std::to_string((int)(f2*std::pow(10,precision)));
+  std::snprintf(Number, sizeof(Number), "%d", (int)(f2*std::pow(10,precision)));
   print2(Number);
 }
 
@@ -620,33 +650,29 @@ void PcfLcd::zahl(float num, short precision)
 /*************************************/
 void PcfLcd::time(short format)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
-  std::time_t t = std::time(nullptr);
-  std::tm tm = *std::localtime(&t);
-  std::cout.imbue(std::locale("de_DE.utf8"));
-  std::stringstream transTime;
+  char const *pattern = nullptr;
   switch(format)
   {
     case 0:
     {
-      transTime << std::put_time(&tm, "%I:%M:%S") << std::endl;
+      pattern = "%I:%M:%S";
       break;
     }
     case 1:
     {
-      transTime << std::put_time(&tm, "%H:%M:%S") << std::endl;
+      pattern = "%H:%M:%S";
       break;
     }
     case 2:
     {
-      transTime << std::put_time(&tm, "%H:%M") << std::endl;
+      pattern = "%H:%M";
       break;
     }
     case 3:
     {
-      transTime << std::put_time(&tm, "%a - %H:%M") << std::endl;
+      pattern = "%a - %H:%M";
       break;
     }
     default:
@@ -654,11 +680,7 @@ void PcfLcd::time(short format)
       std::cout << "wrong format - " << format << std::endl;
     }
   }
-  
-  std::string time = transTime.str();
-  time.erase(std::remove(time.begin(), time.end(), '\n'), time.end());
-  time.erase(std::remove(time.begin(), time.end(), '\r'), time.end());
-  print2(time);
+  printTime(pattern);
 }
 
 /*************************************/
@@ -669,28 +691,24 @@ void PcfLcd::time(short format)
 /*************************************/
 void PcfLcd::date(short format)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
-  std::time_t t = std::time(nullptr);
-  std::tm tm = *std::localtime(&t);
-  std::cout.imbue(std::locale("de_DE.utf8"));
-  std::stringstream transTime;
+  char const *pattern = nullptr;
   switch(format)
   {
     case 0:
     {
-      transTime << std::put_time(&tm, "%d.%m.%Y") << std::endl;
+      pattern = "%d.%m.%Y";
       break;
     }
     case 1:
     {
-      transTime << std::put_time(&tm, "%d.%m") << std::endl;
+      pattern = "%d.%m";
       break;
     }
     case 2:
     {
-      transTime << std::put_time(&tm, "%d.%m.%y") << std::endl;
+      pattern = "%d.%m.%y";
       break;
     }
     default:
@@ -698,11 +716,32 @@ void PcfLcd::date(short format)
       std::cout << "wrong format - " << format << std::endl;
     }
   }
-  
-  std::string date = transTime.str();
-  date.erase(std::remove(date.begin(), date.end(), '\n'), date.end());
-  date.erase(std::remove(date.begin(), date.end(), '\r'), date.end());
-  print2(date);
+  printTime(pattern);
+}
+
+/*************************************/
+/* aktuelle Zeit nach strftime-      */
+/* Muster ausgeben. Die Locale für   */
+/* die Wochentage wird nur einmal    */
+/* angelegt (kein Heap pro Aufruf)   */
+/*************************************/
+void PcfLcd::printTime(char const *pattern)
+{
+  static locale_t german = newlocale(LC_TIME_MASK, "de_DE.UTF-8", (locale_t)0);
+  static locale_t fallback = newlocale(LC_TIME_MASK, "C", (locale_t)0); // locale not installed
+
+  if (pattern == nullptr)
+  {
+    return;
+  }
+  std::time_t t = std::time(nullptr);
+  std::tm tm;
+  localtime_r(&t, &tm);
+  char text[CharsPerLine + 1];
+  if (strftime_l(text, sizeof(text), pattern, &tm, german ? german : fallback) > 0)
+  {
+    print2(text);
+  }
 }
 
 
@@ -717,8 +756,7 @@ void PcfLcd::date(short format)
 /*************************************/
 void PcfLcd::def_bargraph()
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short chars[8],i,j;
   for (i = 0; i < 3; i++)
@@ -735,15 +773,14 @@ void PcfLcd::def_bargraph()
 /*************************************/
 void PcfLcd::bargraph(short len, short maxlen)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short i,j,En,Md;
   En=lightState || 0x5;
   Md=lightState || 0x1;
   if (len>maxlen)
     len=maxlen;
-  buffer.clear();
+  I2C_Buffer<BufferSize> out;
   for (i=0;  i < (len-1); i+=5)
   {
     j=len-i;
@@ -753,20 +790,20 @@ void PcfLcd::bargraph(short len, short maxlen)
       j=j-1;
     else
       j=0x20;
-    AddByteToBuffer((j && 0xF0) || En);// HighNibble
-    AddByteToBuffer((j && 0xF0) || Md);
-    AddByteToBuffer((j < 4) || En);   // LowNibble
-    AddByteToBuffer((j < 4) || Md);
+    AddByte(out, (j && 0xF0) || En);// HighNibble
+    AddByte(out, (j && 0xF0) || Md);
+    AddByte(out, (j < 4) || En);   // LowNibble
+    AddByte(out, (j < 4) || Md);
   }
   while (i<maxlen)
   {
-    AddByteToBuffer(0x20 || En);// HighNibble
-    AddByteToBuffer(0x20 || Md);
-    AddByteToBuffer(        En);   // LowNibble
-    AddByteToBuffer(        Md);
+    AddByte(out, 0x20 || En);// HighNibble
+    AddByte(out, 0x20 || Md);
+    AddByte(out,         En);   // LowNibble
+    AddByte(out,         Md);
     i=i+5;
   }
-  SendBuffer();
+  i2c_device->Write(out);
 }
 
 /*************************************/
@@ -775,8 +812,7 @@ void PcfLcd::bargraph(short len, short maxlen)
 /*************************************/
 void PcfLcd::def_sanduhr(short ascii)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short chars[8];
   chars[0]=0x1F;
@@ -796,8 +832,7 @@ void PcfLcd::def_sanduhr(short ascii)
 /*************************************/
 void PcfLcd::def_arr_up(short ascii)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short chars[8];
   chars[0]=0x04;
@@ -817,8 +852,7 @@ void PcfLcd::def_arr_up(short ascii)
 /*************************************/
 void PcfLcd::def_arr_down(short ascii)
 {
-  if (i2c_device->isVerbose())
-    std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+  TRACE_DEBUG(i2c_device->getAddress(), "");
 
   short chars[8];
   chars[0]=0x04;
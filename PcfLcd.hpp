@@ -13,8 +13,10 @@
 
 #include "I2C_Device.hpp"
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <string>
-#include <vector>
 
 const short PCF_Addr[16] = {0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, //PCF8574-Adressen
                             0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F};
@@ -25,7 +27,8 @@ private:
     I2C_Interface *i2c_device;
 
 public:
-    PcfLcd(I2C_Device *i2c_dev, short PcfNr, bool backlight);
+    PcfLcd(I2C_Interface *i2c_dev, short PcfNr, bool backlight);
+    PcfLcd(PcfLcd const &other);
     ~PcfLcd();
 
 //    void SetPcf(short PcfNr);
@@ -35,6 +38,8 @@ public:
     void defineChar(short addr, short chararacter[]);
     void defineGermanChars();
     
+    // byte-wise output through the member buffer - caller thread only,
+    // the output functions below build their nibble streams locally
     short AddByteToBuffer(short byte, bool clearbuffer = false);
     bool SendBuffer();
     void WriteCmd(short const cmd, bool const fourBitMode = true);
@@ -51,10 +56,16 @@ public:
     void setcursor(short cursor);
     void put(short chararacter);
     
-    void print2(std::string text);
-    void print(std::string s);
+    void print2(char const *text);
+    void print2(std::string const &text);
+    void print(std::string const &s);
     void printlength(short s[], short len);
 
+    // asynchronous output - executed by the worker of the bus; may be mixed
+    // with the synchronous output of the caller thread
+    std::future<bool> print2Async(std::string text);
+    std::future<bool> updateAsync(std::function<void(PcfLcd &)> update);
+
     void ziff(short num);
     void zahl(int num);
     void zahl(float num, short precision);
@@ -70,12 +81,18 @@ public:
 
 
 protected :
-    short lightState;
-
-    std::vector<unsigned char> buffer;
+    std::atomic<short> lightState;
 
     static const short NumerOfLines = 4;                              // für 4x20 & zweizeilige LCD
     static const short CharsPerLine = 20;                             // für 4x20 & zweizeilige LCD
+    static const short BufferSize = 4 * CharsPerLine;                 // bargraph: 4 Bytes pro Zeichen
+
+    I2C_Buffer<BufferSize> buffer;
+
+    template <int Capacity>
+    void AddByte(I2C_Buffer<Capacity> &out, short byte){out.push_back(byte | lightState);}
+
+    void printTime(char const *pattern);
     const short Line[NumerOfLines] = {0x80, 0xC0, 0x94, 0xD4}; // für 4x20 & zweizeilige LCD
     //const CharsPerLine=16;                  // für 4x16 LCD
     //const Line[]= 0x80,0x80,0xC0,0x90,0xD0; // für 4x16 LCD
@@ -0,0 +1,379 @@
+/**
+ * @file PcfLcd_sim.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief emulator of a HD44780 display behind a PCF8574 (PcfLcd wiring)
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+/******************************************************************/
+/* PCF.7 PCF.6 PCF.5 PCF.4 PCF.3 PCF.2 PCF.1 PCF.0                */
+/* D7    D6    D5    D4    Light Enab  R/W   RS                   */
+/* the HD44780 latches D7..D4 on the falling edge of Enable       */
+/******************************************************************/
+
+#include <algorithm>
+#include <iomanip>
+
+#include "PcfLcd_sim.hpp"
+
+#define PCF_PIN_RS     0x01
+#define PCF_PIN_RW     0x02
+#define PCF_PIN_E      0x04
+#define PCF_PIN_LIGHT  0x08
+#define PCF_PIN_DATA   0xF0
+
+#define HD44780_LINE2  0x40 // DDRAM start of the second controller line
+#define HD44780_LINE_LENGTH 0x28
+
+static PcfLcd_Counters operator-(PcfLcd_Counters const &a, PcfLcd_Counters const &b)
+{
+    return PcfLcd_Counters{a.transfers - b.transfers, a.wireBytes - b.wireBytes, a.pulses - b.pulses,
+                           a.commands - b.commands, a.data - b.data};
+}
+
+static void operator+=(PcfLcd_Counters &a, PcfLcd_Counters const &b)
+{
+    a.transfers += b.transfers;
+    a.wireBytes += b.wireBytes;
+    a.pulses += b.pulses;
+    a.commands += b.commands;
+    a.data += b.data;
+}
+
+/**
+ * @brief Construct a new emulator in power-on state (8 bit interface)
+ * 
+ * @param lines number of display lines (1, 2 or 4)
+ * @param columns characters per line
+ */
+PcfLcd_Sim::PcfLcd_Sim(short lines, short columns)
+    : numLines(lines), numColumns(columns),
+      outputs(0xFF), backlight(true),
+      eightBitMode(true), highNibblePending(false), highNibble(0), readLowNibble(false),
+      ddram(0x80, ' '), cgram(0x40, 0),
+      addressCounter(0), addressCgram(false), entryIncrement(true), entryShift(false),
+      displayOn(false), cursorOn(false), blinkOn(false), twoLines(false), displayShift(0),
+      counters{0, 0, 0, 0, 0}
+{
+}
+
+PcfLcd_Sim::~PcfLcd_Sim()
+{
+}
+
+/**
+ * @brief every byte written to the PCF8574 sets its 8 output pins
+ */
+bool PcfLcd_Sim::Write(unsigned char const *buffer, const int length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    counters.transfers++;
+    counters.wireBytes += length;
+    for (int i = 0; i < length; i++)
+    {
+        Pins(buffer[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief reading the PCF8574 returns the pin levels; while R/W and E are
+ *        high the HD44780 drives D7..D4 (busy flag/address or data)
+ */
+bool PcfLcd_Sim::Read(unsigned char *buffer, const int length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned char pins = outputs;
+    if ((outputs & PCF_PIN_RW) && (outputs & PCF_PIN_E))
+    {
+        unsigned char value = (outputs & PCF_PIN_RS) ? (addressCgram ? cgram[addressCounter & 0x3F] : ddram[addressCounter & 0x7F])
+                                                     : (addressCounter & 0x7F); // busy flag is never set
+        unsigned char nibble = readLowNibble ? (value & 0x0F) : (value >> 4);
+        pins = (outputs & ~PCF_PIN_DATA) | (nibble << 4);
+    }
+    for (int i = 0; i < length; i++)
+    {
+        buffer[i] = pins;
+    }
+    return true;
+}
+
+/**
+ * @brief new pin state of the PCF8574 (lock must be held)
+ */
+void PcfLcd_Sim::Pins(unsigned char pins)
+{
+    bool fallingEnable = (outputs & PCF_PIN_E) && !(pins & PCF_PIN_E);
+    backlight = (pins & PCF_PIN_LIGHT) != 0;
+    if (fallingEnable)
+    {
+        counters.pulses++;
+        if (outputs & PCF_PIN_RW)
+        {
+            // end of a read cycle - after the low nibble of a data read the address advances
+            if (readLowNibble && (outputs & PCF_PIN_RS))
+                Advance();
+            readLowNibble = !eightBitMode && !readLowNibble;
+        }
+        else
+        {
+            Latch((outputs & PCF_PIN_RS) != 0, outputs & PCF_PIN_DATA);
+        }
+    }
+    outputs = pins;
+}
+
+/**
+ * @brief D7..D4 latched by the controller (lock must be held)
+ * 
+ * @param registerSelect true for data, false for instructions
+ * @param value D7..D4 in the upper nibble
+ */
+void PcfLcd_Sim::Latch(bool registerSelect, unsigned char value)
+{
+    unsigned char byte;
+    if (eightBitMode)
+    {
+        byte = value; // D3..D0 are not connected
+    }
+    else if (!highNibblePending)
+    {
+        highNibble = value;
+        highNibblePending = true;
+        return;
+    }
+    else
+    {
+        byte = highNibble | (value >> 4);
+        highNibblePending = false;
+    }
+
+    if (registerSelect)
+        WriteData(byte);
+    else
+        Instruction(byte);
+}
+
+/**
+ * @brief move the address counter according to the entry mode (lock must be held)
+ */
+void PcfLcd_Sim::Advance()
+{
+    if (addressCgram)
+    {
+        addressCounter = (addressCounter + (entryIncrement ? 1 : -1)) & 0x3F;
+        return;
+    }
+    if (!twoLines)
+    {
+        addressCounter = (addressCounter + (entryIncrement ? 1 : 2 * HD44780_LINE_LENGTH - 1)) % (2 * HD44780_LINE_LENGTH);
+        return;
+    }
+    if (entryIncrement)
+    {
+        if (addressCounter == HD44780_LINE_LENGTH - 1)
+            addressCounter = HD44780_LINE2;
+        else if (addressCounter == HD44780_LINE2 + HD44780_LINE_LENGTH - 1)
+            addressCounter = 0;
+        else
+            addressCounter++;
+    }
+    else
+    {
+        if (addressCounter == 0)
+            addressCounter = HD44780_LINE2 + HD44780_LINE_LENGTH - 1;
+        else if (addressCounter == HD44780_LINE2)
+            addressCounter = HD44780_LINE_LENGTH - 1;
+        else
+            addressCounter--;
+    }
+}
+
+/**
+ * @brief character or CGRAM row (lock must be held)
+ */
+void PcfLcd_Sim::WriteData(unsigned char value)
+{
+    counters.data++;
+    if (addressCgram)
+        cgram[addressCounter & 0x3F] = value;
+    else
+        ddram[addressCounter & 0x7F] = value;
+    Advance();
+    if (entryShift && !addressCgram)
+        displayShift += entryIncrement ? 1 : -1;
+}
+
+/**
+ * @brief execute a HD44780 instruction (lock must be held)
+ */
+void PcfLcd_Sim::Instruction(unsigned char cmd)
+{
+    counters.commands++;
+    if (cmd & 0x80) // set DDRAM address
+    {
+        addressCounter = cmd & 0x7F;
+        addressCgram = false;
+    }
+    else if (cmd & 0x40) // set CGRAM address
+    {
+        addressCounter = cmd & 0x3F;
+        addressCgram = true;
+    }
+    else if (cmd & 0x20) // function set
+    {
+        bool eightBit = (cmd & 0x10) != 0;
+        if (eightBit != eightBitMode)
+        {
+            highNibblePending = false;
+            readLowNibble = false;
+        }
+        eightBitMode = eightBit;
+        twoLines = (cmd & 0x08) != 0;
+    }
+    else if (cmd & 0x10) // cursor / display shift
+    {
+        bool right = (cmd & 0x04) != 0;
+        if (cmd & 0x08)
+        {
+            displayShift += right ? -1 : 1;
+        }
+        else
+        {
+            bool increment = entryIncrement;
+            entryIncrement = right;
+            Advance();
+            entryIncrement = increment;
+        }
+    }
+    else if (cmd & 0x08) // display on/off control
+    {
+        displayOn = (cmd & 0x04) != 0;
+        cursorOn = (cmd & 0x02) != 0;
+        blinkOn = (cmd & 0x01) != 0;
+    }
+    else if (cmd & 0x04) // entry mode set
+    {
+        entryIncrement = (cmd & 0x02) != 0;
+        entryShift = (cmd & 0x01) != 0;
+    }
+    else if (cmd & 0x02) // return home
+    {
+        addressCounter = 0;
+        addressCgram = false;
+        displayShift = 0;
+    }
+    else if (cmd & 0x01) // clear display
+    {
+        std::fill(ddram.begin(), ddram.end(), ' ');
+        addressCounter = 0;
+        addressCgram = false;
+        entryIncrement = true;
+        displayShift = 0;
+    }
+}
+
+/**
+ * @brief visible content as text, one display line per text line
+ * 
+ * @return framed screen content; CGRAM characters are shown as '#'
+ */
+std::string PcfLcd_Sim::Snapshot()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::string frame = "+" + std::string(numColumns, '-') + "+\n";
+    std::string screen = frame;
+    for (short row = 0; row < numLines; row++)
+    {
+        // 4 line displays continue line 0/1 of the controller in line 2/3
+        int start = ((row & 1) ? HD44780_LINE2 : 0) + ((row & 2) ? numColumns : 0);
+        // in 1 line mode the controller has a single line of 80 characters at 0
+        int lineStart = (twoLines && (row & 1)) ? HD44780_LINE2 : 0;
+        int lineLength = twoLines ? HD44780_LINE_LENGTH : 2 * HD44780_LINE_LENGTH;
+        screen += "|";
+        for (short col = 0; col < numColumns; col++)
+        {
+            int offset = (start - lineStart + col + displayShift) % lineLength;
+            if (offset < 0)
+                offset += lineLength;
+            unsigned char character = ddram[lineStart + offset];
+            if (!displayOn)
+                character = ' ';
+            else if (character < 0x10)
+                character = '#';
+            else if ((character < 0x20) || (character > 0x7E))
+                character = '?';
+            screen += (char)character;
+        }
+        screen += "|\n";
+    }
+    return screen + frame;
+}
+
+/**
+ * @brief draw the screen on an ANSI terminal (backlight as background colour)
+ */
+void PcfLcd_Sim::Render(std::ostream &out)
+{
+    std::string screen = Snapshot();
+    out << "\x1b[H\x1b[2J";
+    if (isBacklightOn())
+        out << "\x1b[30;42m";
+    out << screen << "\x1b[0m" << std::flush;
+}
+
+PcfLcd_Counters PcfLcd_Sim::GetCounters()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+/**
+ * @brief run a PcfLcd call and book the traffic it caused under a name
+ * 
+ * @param call name of the call, e.g. "print2"
+ * @param action the PcfLcd call(s) to account
+ */
+void PcfLcd_Sim::Measure(std::string const &call, std::function<void()> action)
+{
+    PcfLcd_Counters before = GetCounters();
+    action();
+    PcfLcd_Counters delta = GetCounters() - before;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (calls.find(call) == calls.end())
+    {
+        callOrder.push_back(call);
+        calls[call] = std::make_pair(0UL, PcfLcd_Counters{0, 0, 0, 0, 0});
+    }
+    calls[call].first++;
+    calls[call].second += delta;
+}
+
+/**
+ * @brief print the traffic of all measured calls
+ */
+void PcfLcd_Sim::PrintMeasurements(std::ostream &out)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    out << std::dec << std::setfill(' ')
+        << std::left << std::setw(16) << "call" << std::right
+        << std::setw(7) << "count" << std::setw(10) << "transfers" << std::setw(8) << "bytes"
+        << std::setw(8) << "pulses" << std::setw(6) << "cmds" << std::setw(6) << "data" << std::endl;
+    for (auto const &call : callOrder)
+    {
+        std::pair<unsigned long, PcfLcd_Counters> const &entry = calls[call];
+        out << std::left << std::setw(16) << call << std::right
+            << std::setw(7) << entry.first << std::setw(10) << entry.second.transfers
+            << std::setw(8) << entry.second.wireBytes << std::setw(8) << entry.second.pulses
+            << std::setw(6) << entry.second.commands << std::setw(6) << entry.second.data << std::endl;
+    }
+    out << std::left << std::setw(16) << "total" << std::right
+        << std::setw(7) << "" << std::setw(10) << counters.transfers
+        << std::setw(8) << counters.wireBytes << std::setw(8) << counters.pulses
+        << std::setw(6) << counters.commands << std::setw(6) << counters.data << std::endl;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file PcfLcd_sim.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief emulator of a HD44780 display behind a PCF8574 (PcfLcd wiring)
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_SimBus.hpp"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief traffic counters of the emulated display
+ * 
+ */
+struct PcfLcd_Counters
+{
+    unsigned long transfers;  // i2c write messages to the PCF8574
+    unsigned long wireBytes;  // bytes clocked into the PCF8574
+    unsigned long pulses;     // falling edges of E (nibbles latched)
+    unsigned long commands;   // complete HD44780 instructions
+    unsigned long data;       // complete characters / CGRAM rows
+};
+
+class PcfLcd_Sim : public I2C_SimDevice
+{
+public:
+    PcfLcd_Sim(short lines = 4, short columns = 20);
+    ~PcfLcd_Sim();
+
+    virtual bool Write(unsigned char const *buffer, const int length);
+    virtual bool Read(unsigned char *buffer, const int length);
+
+    std::string Snapshot();
+    void Render(std::ostream &out);
+
+    PcfLcd_Counters GetCounters();
+    void Measure(std::string const &call, std::function<void()> action);
+    void PrintMeasurements(std::ostream &out);
+
+    // decoded controller state
+    bool isBacklightOn(){return backlight;}
+    bool isFourBitMode(){return !eightBitMode;}
+    unsigned char getAddressCounter(){return addressCounter;}
+    unsigned char getDdram(unsigned char address){return ddram[address & 0x7F];}
+    unsigned char getCgram(unsigned char address){return cgram[address & 0x3F];}
+
+private:
+    void Pins(unsigned char pins);
+    void Latch(bool registerSelect, unsigned char value);
+    void Instruction(unsigned char cmd);
+    void WriteData(unsigned char value);
+    void Advance();
+
+    std::mutex lock;
+    short numLines;
+    short numColumns;
+
+    // PCF8574 output latch
+    unsigned char outputs;
+    bool backlight;
+
+    // HD44780 interface state
+    bool eightBitMode;
+    bool highNibblePending;
+    unsigned char highNibble;
+    bool readLowNibble;
+
+    // HD44780 controller state
+    std::vector<unsigned char> ddram;
+    std::vector<unsigned char> cgram;
+    unsigned char addressCounter;
+    bool addressCgram;
+    bool entryIncrement;
+    bool entryShift;
+    bool displayOn;
+    bool cursorOn;
+    bool blinkOn;
+    bool twoLines;
+    int displayShift;
+
+    PcfLcd_Counters counters;
+    std::vector<std::string> callOrder;
+    std::map<std::string, std::pair<unsigned long, PcfLcd_Counters> > calls;
+};
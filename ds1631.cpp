@@ -12,60 +12,43 @@
 //https://raspberry-projects.com/pi/programming-in-c/i2c/using-the-i2c-interface
 
 #include <iostream>
-#include <iomanip>
 #include <stdio.h>
 #include <stdint.h>
-#include <typeinfo>
 #include <unistd.h>           //Needed for I2C port
 #include <fcntl.h>           //Needed for I2C port
 #include <sys/ioctl.h>     //Needed for I2C port
 #include <linux/i2c-dev.h> //Needed for I2C port
 #include <stdbool.h>
+#include <algorithm>
 #include <cmath>
+#include <memory>
+#include <thread>
 
 #include "ds1631.hpp"
 
-// defines from datasheet
-#define DS1631_START_CONVERT_T 0x51
-#define DS1631_STOP_CONVERT_T 0x22
-#define DS1631_READ_TEMPERATURE 0xAA
-#define DS1631_ACCESS_TH 0xA1
-#define DS1631_ACCESS_TL 0xA2
-#define DS1631_ACCESS_CONFIG 0xAC
-#define DS1631_SOFTWARE_POR 0x54
-
-#define DS1631_CONFIG_CONVERSTION_DONE_FLAG (1 << 7)
-#define DS1631_CONFIG_CONVERSTION_IN_PROGRESS 0
-#define DS1631_CONFIG_CONVERSTION_COMPLETE 1
-#define DS1631_CONFIG_TEMP_HIGH_FLAG (1 << 6)
-#define DS1631_CONFIG_TEMP_HIGH_OVERFLOW_INACTIVE 0
-#define DS1631_CONFIG_TEMP_HIGH_OVERFLOW_ACTIVE 1
-#define DS1631_CONFIG_TEMP_LOW_FLAG (1 << 5)
-#define DS1631_CONFIG_TEMP_LOW_OVERFLOW_INACTIVE 0
-#define DS1631_CONFIG_TEMP_LOW_OVERFLOW_ACTIVE 1
-#define DS1631_CONFIG_NVM_BUSY_FLAG (1 << 4)
-#define DS1631_CONFIG_NVM_NOT_BUSY 0
-#define DS1631_CONFIG_NVM_BUSY 1
-#define DS1631_CONFIG_RESOLUTION_BIT1 (1 << 3)
-#define DS1631_CONFIG_RESOLUTION_BIT0 (1 << 2)
-#define DS1631_CONFIG_09BIT_094MS 0
-#define DS1631_CONFIG_10BIT_188MS 1
-#define DS1631_CONFIG_11BIT_375MS 2
-#define DS1631_CONFIG_12BIT_750MS 3
-#define DS1631_CONFIG_TOUT_POLARITY (1 << 1)
-#define DS1631_CONFIG_ACTIVE_LOW 0
-#define DS1631_CONFIG_ACTIVE_HIGH 1
-#define DS1631_CONFIG_1SHOT_CONVERSION (1 << 0)
-#define DS1631_CONFIG_CONTINUOUS_MODE 0
-#define DS1631_CONFIG_ONE_SHOT_MODE 1
+#define TRACE_COMPONENT "DS1631"
+#include "tracer.hpp"
+
+// a status poll loop reads all flags within this time with one transfer
+const std::chrono::microseconds DS1631::DefaultStatusFreshness(10000);
+// EEPROM write cycle by the datasheet
+const std::chrono::microseconds DS1631::NvmWriteTime(10000);
+// NVB is given up on this long after the expected end of the cycle
+static const std::chrono::microseconds NvmTimeout(40000);
+static const std::chrono::microseconds NvmPoll(1000);
 
 /**
  * @brief Construct a new DS1631::DS1631 object
  * 
  * @param i2c_device 
  */
-DS1631::DS1631(I2C_Device* i2c_dev) : i2c_device(i2c_dev)
+DS1631::DS1631(I2C_Interface* i2c_dev)
+    : i2c_device(i2c_dev), configShadow(0), configShadowValid(false),
+      statusFreshness(DefaultStatusFreshness), converting(false), nvmPending(false), nvmWrites(0),
+      nvmWritesSkipped(0)
 {
+    tripKnown[0] = false;
+    tripKnown[1] = false;
 
 }
 
@@ -78,23 +61,6 @@ DS1631::~DS1631()
 
 }
 
-void DS1631::ConvertCompl2Byte(const float & complement, short& int_byte, short& float_byte)
-{
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    int_byte = (int)complement;
-    float useit = complement;
-    float forgetit;
-    float_byte = std::modf(useit, &forgetit) * 256;
-}
-
-void DS1631::ConvertByte2Compl(const short& int_byte, const short& float_byte, float& complement)
-{
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    complement = int_byte + (float)float_byte / 256;
-}
-
 /**************************************
  * DS1631 protcol implementation
  **************************************/
@@ -104,11 +70,15 @@ void DS1631::ConvertByte2Compl(const short& int_byte, const short& float_byte, f
  */
 bool DS1631::StartConvert()
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    unsigned char buffer[1] = {0};
-    buffer[0] = DS1631_START_CONVERT_T;
-    return i2c_device->WriteByte(buffer, 1);
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    DS1631_Buffer command;
+    command.push_back(DS1631_START_CONVERT_T);
+    // DONE changes with the conversion state
+    statusReadAt = std::chrono::steady_clock::time_point();
+    if (!i2c_device->Write(command))
+        return false;
+    ScheduleConversion();
+    return true;
 }
 
 /*!
@@ -117,36 +87,234 @@ bool DS1631::StartConvert()
  */
 bool DS1631::StopConvert()
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    unsigned char buffer[1] = {0};
-    buffer[0] = DS1631_STOP_CONVERT_T;
-    return i2c_device->WriteByte(buffer, 1);
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    DS1631_Buffer command;
+    command.push_back(DS1631_STOP_CONVERT_T);
+    // DONE changes with the conversion state
+    statusReadAt = std::chrono::steady_clock::time_point();
+    converting = false;
+    return i2c_device->Write(command);
 }
 
 /*!
  * \brief read temperature temperature
  * sudo i2cget -y 1 0x4C 0xaa
  * 
- * \return temperature in °C
+ * \return temperature in °C - NAN if the sensor did not answer
  */
 float DS1631::ReadTemperature()
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    unsigned char buffer[2] = {0};
-    buffer[0] = DS1631_READ_TEMPERATURE;
-    i2c_device->WriteByte(buffer, 1);
-    float temperature = 0;
-    if (i2c_device->ReadByte(buffer, 2))
+    return Read().Celsius();
+}
+
+/*!
+ * \brief read the temperature and tell whether it is valid
+ * 
+ * \return reading of this sensor
+ */
+DS1631_Reading DS1631::Read()
+{
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    DS1631_Buffer command, reply;
+    command.push_back(DS1631_READ_TEMPERATURE);
+    reply.resize(2);
+    DS1631_Reading reading = {i2c_device->getAddress(), false, DS1631_Temperature()};
+    if (i2c_device->WriteRead(command, reply))
+    {
+        reading.valid = true;
+        reading.value = DS1631_Temperature::FromRegister(reply[0], reply[1]);
+        TRACE_DEBUG(i2c_device->getAddress(), "data read: {}m°C", reading.value.MilliCelsius());
+    }
+    return reading;
+}
+
+/*!
+ * \brief conversion time of the configured resolution - 93.75ms at 9 bit
+ *        up to 750ms at 12 bit; the worst case if the config is unknown
+ */
+std::chrono::microseconds DS1631::ConversionTime()
+{
+    short config = CachedConfig(DS1631_CONFIG_SETUP_BITS);
+    if (!configShadowValid)
+    {
+        config = DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0;
+    }
+    return DecodeConfig(config).conversionTime;
+}
+
+/*!
+ * \brief note the time the result of a just started conversion is due.
+ *        A running continuous conversion is not restarted by the chip,
+ *        so its due time is kept.
+ */
+void DS1631::ScheduleConversion()
+{
+    bool oneShot = (0 != (CachedConfig(DS1631_CONFIG_SETUP_BITS) & DS1631_CONFIG_1SHOT_CONVERSION));
+    if (converting && !oneShot)
+    {
+        return;
+    }
+    std::chrono::microseconds duration = ConversionTime();
+    conversionDue = std::chrono::steady_clock::now() + duration;
+    converting = true;
+}
+
+/*!
+ * \brief one-shot mode: poll DONE until it is set. The chip is done at the
+ *        due time by the datasheet, so this normally takes a single read;
+ *        slower chips are polled at 1/16 of the conversion time for at
+ *        most one more conversion time.
+ * 
+ * \return false if DONE was not seen or the sensor did not answer
+ */
+bool DS1631::PollConversionDone()
+{
+    std::chrono::microseconds duration = ConversionTime();
+    std::chrono::microseconds interval = std::max(duration / 16, std::chrono::microseconds(2000));
+    std::chrono::steady_clock::time_point deadline = conversionDue + duration;
+    for (;;)
+    {
+        short config = ReadConfig();
+        if (!configShadowValid)
+        {
+            return false;
+        }
+        if (config & DS1631_CONFIG_CONVERSTION_DONE_FLAG)
+        {
+            converting = false;
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            TRACE_ERROR(i2c_device->getAddress(), "conversion not done after {}us", (duration * 2).count());
+            return false;
+        }
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+/*!
+ * \brief wait until the started conversion delivered its result: sleep
+ *        until it is due, in one-shot mode confirm it with the DONE flag.
+ *        Returns at once if no conversion is pending.
+ * 
+ * \return false if the conversion did not finish
+ */
+bool DS1631::WaitForConversion()
+{
+    if (!converting)
+    {
+        return true;
+    }
+    std::this_thread::sleep_until(conversionDue);
+    if (!(CachedConfig(DS1631_CONFIG_SETUP_BITS) & DS1631_CONFIG_1SHOT_CONVERSION))
     {
-        ConvertByte2Compl(buffer[0] , buffer[1], temperature);
-        if (i2c_device->isVerbose())
-            std::cout << "--Data read: " << std::dec << std::setprecision(5) << temperature << "°C" << std::endl;
+        return true;
     }
+    return PollConversionDone();
+}
+
+/*!
+ * \brief time the conversion finished whose result the temperature
+ *        register holds at the given time - derived from the due time
+ *        and, in continuous mode, the conversion period
+ * 
+ * \param at time the register was read
+ * \return end of the latest finished conversion; at itself if it is not
+ *         known (no conversion started by this object)
+ */
+std::chrono::steady_clock::time_point DS1631::ConversionFinished(std::chrono::steady_clock::time_point at)
+{
+    if (conversionDue == std::chrono::steady_clock::time_point())
+    {
+        return at;
+    }
+    bool oneShot = (0 != (CachedConfig(DS1631_CONFIG_SETUP_BITS) & DS1631_CONFIG_1SHOT_CONVERSION));
+    if (oneShot || !converting)
+    {
+        return (at >= conversionDue) ? conversionDue : at;
+    }
+    std::chrono::steady_clock::duration period = ConversionTime();
+    if (at < conversionDue)
+    {
+        // the first conversion is still running - the register holds an older result
+        return at;
+    }
+    return conversionDue + ((at - conversionDue) / period) * period;
+}
+
+/*!
+ * \brief read a temperature converted after this call: one-shot mode
+ *        starts a conversion, continuous mode is started if it is not
+ *        running yet; waits only as long as the resolution requires
+ * 
+ * \return reading of this sensor
+ */
+DS1631_Reading DS1631::ReadFresh()
+{
+    bool oneShot = (0 != (CachedConfig(DS1631_CONFIG_SETUP_BITS) & DS1631_CONFIG_1SHOT_CONVERSION));
+    if ((oneShot || !converting) && !StartConvert())
+    {
+        DS1631_Reading reading = {i2c_device->getAddress(), false, DS1631_Temperature()};
+        return reading;
+    }
+    if (!WaitForConversion())
+    {
+        DS1631_Reading reading = {i2c_device->getAddress(), false, DS1631_Temperature()};
+        return reading;
+    }
+    return Read();
+}
+
+/*!
+ * \brief start the conversion without waiting for the bus.
+ *        The object has to live until the future is ready.
+ * 
+ * \return future delivering the result of StartConvert()
+ */
+std::future<bool> DS1631::StartConvertAsync()
+{
+    return i2c_device->Submit([this] { return StartConvert(); });
+}
+
+/*!
+ * \brief read the temperature without waiting for the bus.
+ *        The object has to live until the future is ready.
+ * 
+ * \return future delivering the temperature in °C (NAN without data)
+ */
+std::future<float> DS1631::ReadTemperatureAsync()
+{
+    std::shared_ptr<std::promise<float> > result = std::make_shared<std::promise<float> >();
+    std::future<float> temperature = result->get_future();
+    i2c_device->Submit([this, result] {
+        result->set_value(ReadTemperature());
+        return true;
+    });
     return temperature;
 }
 
+/*!
+ * \brief read the temperature without waiting for the bus; done is called
+ *        on the bus worker with the transfer result and the temperature
+ * 
+ * \param done completion callback
+ */
+void DS1631::ReadTemperatureAsync(std::function<void(bool, float)> done)
+{
+    std::shared_ptr<float> temperature = std::make_shared<float>(NAN);
+    I2C_Interface::Transaction read = [this, temperature] {
+        DS1631_Buffer command, reply;
+        command.push_back(DS1631_READ_TEMPERATURE);
+        reply.resize(2);
+        if (!i2c_device->WriteRead(command, reply))
+            return false;
+        *temperature = DS1631_Temperature::FromRegister(reply[0], reply[1]).Celsius();
+        return true;
+    };
+    i2c_device->Submit(read, [temperature, done](bool ok) { done(ok, *temperature); });
+}
+
 //**************
 // config read
 //**************
@@ -158,43 +326,43 @@ float DS1631::ReadTemperature()
  */
 bool DS1631::ConfigIsConversionDone()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_CONVERSTION_DONE_FLAG);
 	return (0 != (config & DS1631_CONFIG_CONVERSTION_DONE_FLAG));
 }
 
 bool DS1631::ConfigIsTempHighFlagSet()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_TEMP_HIGH_FLAG);
 	return (0 != (config & DS1631_CONFIG_TEMP_HIGH_FLAG));
 }
 
 bool DS1631::ConfigIsTempLowFlagSet()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_TEMP_LOW_FLAG);
 	return (0 != (config & DS1631_CONFIG_TEMP_LOW_FLAG));
 }
 
 bool DS1631::ConfigIsNvMBusy()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_NVM_BUSY_FLAG);
 	return (0 != (config & DS1631_CONFIG_NVM_BUSY_FLAG));
 }
 
 bool DS1631::ConfigIsToutPolarityHigh()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_TOUT_POLARITY);
 	return (0 != (config & DS1631_CONFIG_TOUT_POLARITY));
 }
 
 bool DS1631::ConfigIs1ShotModeActive()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_1SHOT_CONVERSION);
 	return (0 != (config & DS1631_CONFIG_1SHOT_CONVERSION));
 }
 
 short DS1631::ConfigGetResolutionAndConversionTime()
 {
-	short config=ReadConfig();
+	short config=CachedConfig(DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0);
 	short ResolutionAndTime = config & (DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0);
 	ResolutionAndTime = ResolutionAndTime >> 2;
 	return ResolutionAndTime;
@@ -205,7 +373,7 @@ short DS1631::ConfigGetResolutionAndConversionTime()
 //***********
 bool DS1631::SetConfigConversionDone(bool state)
 {
-	short config = ReadConfig();
+	short config = CachedConfig(DS1631_CONFIG_STATUS_BITS | DS1631_CONFIG_SETUP_BITS);
 	if (state)
 	{
 		config |= DS1631_CONFIG_CONVERSTION_DONE_FLAG;
@@ -219,35 +387,17 @@ bool DS1631::SetConfigConversionDone(bool state)
 
 bool DS1631::SetConfigTempHighFlagSet(bool state)
 {
-	short config = ReadConfig();
-	if (state)
-	{
-		config |= DS1631_CONFIG_TEMP_HIGH_FLAG;
-	}
-	else
-	{
-		config &= ~DS1631_CONFIG_TEMP_HIGH_FLAG;
-	}
-	return WriteConfig(config);
+	return Config().Set<DS1631_Config::TempHighFlag>(state ? 1 : 0).Commit();
 }
 
 bool DS1631::SetConfigTempLowFlagSet(bool state)
 {
-	short config = ReadConfig();
-	if (state)
-	{
-		config |= DS1631_CONFIG_TEMP_LOW_FLAG;
-	}
-	else
-	{
-		config &= ~DS1631_CONFIG_TEMP_LOW_FLAG;
-	}
-	return WriteConfig(config);
+	return Config().Set<DS1631_Config::TempLowFlag>(state ? 1 : 0).Commit();
 }
 
 bool DS1631::SetConfigNvMBusy(bool state)
 {
-	short config = ReadConfig();
+	short config = CachedConfig(DS1631_CONFIG_STATUS_BITS | DS1631_CONFIG_SETUP_BITS);
 	if (state)
 	{
 		config |= DS1631_CONFIG_NVM_BUSY_FLAG;
@@ -261,239 +411,854 @@ bool DS1631::SetConfigNvMBusy(bool state)
 
 bool DS1631::SetConfigToutPolarityHigh(bool state)
 {
-	short config = ReadConfig();
-	if (state)
-	{
-		config |= DS1631_CONFIG_TOUT_POLARITY;
-	}
-	else
-	{
-		config &= ~DS1631_CONFIG_TOUT_POLARITY;
-	}
-	return WriteConfig(config);
+	return Config().Set<DS1631_Config::ToutPolarity>(state ? 1 : 0).Commit();
 }
 
 bool DS1631::SetConfig1ShotModeActive(bool state)
 {
-	short config = ReadConfig();
-	if (state)
-	{
-		config |= DS1631_CONFIG_1SHOT_CONVERSION;
-	}
-	else
-	{
-		config &= ~DS1631_CONFIG_1SHOT_CONVERSION;
-	}
-	return WriteConfig(config);
+	return Config().Set<DS1631_Config::OneShot>(state ? 1 : 0).Commit();
 }
 
 bool DS1631::ConfigSetResolutionAndConversionTime(short ResolutionAndConverstionTime)
 {
-	short config = ReadConfig();
-	config &= ~ (3<<2); // clear both bits first
-	config |= (ResolutionAndConverstionTime<<2);
-	return WriteConfig(config);
+	return Config().Set<DS1631_Config::Resolution>(ResolutionAndConverstionTime).Commit();
+}
+
+/**
+ * \brief apply the collected field changes with one read-modify-write of
+ *        the config register. The write (and the EEPROM cycle a change of
+ *        POL or 1SHOT starts) is skipped if all fields already have their new values.
+ * 
+ * \return false if a value did not fit its field or the sensor failed
+ */
+bool DS1631::ConfigTransaction::Commit()
+{
+    if (rangeError)
+    {
+        TRACE_ERROR(sensor.i2c_device->getAddress(), "config value out of range");
+        return false;
+    }
+    if (mask == 0)
+    {
+        return true;
+    }
+    short config = sensor.CachedConfig(DS1631_CONFIG_STATUS_BITS | DS1631_CONFIG_SETUP_BITS);
+    if (!sensor.configShadowValid)
+    {
+        return false;
+    }
+    short update = (config & ~mask) | (value & mask);
+    if (update == config)
+    {
+        TRACE_DEBUG(sensor.i2c_device->getAddress(), "config {x} unchanged", config);
+        return true;
+    }
+    return sensor.WriteConfig(update);
 }
 
 /**
- * \brief read the config register and print the result
+ * \brief config register from the shadow - the bus is only read if the
+ *        setup bits are unknown or status bits are requested and older
+ *        than the freshness window
+ * 
+ * \param bits bits of the register the caller is interested in
+ * \return short config of DS1631 (0 if the sensor did not answer)
+ */
+short DS1631::CachedConfig(short bits)
+{
+    bool stale = !configShadowValid;
+    if (!stale && (bits & DS1631_CONFIG_STATUS_BITS))
+    {
+        stale = !isStatusFresh();
+    }
+    if (stale)
+    {
+        return ReadConfig();
+    }
+    return configShadow;
+}
+
+/**
+ * \brief true if the status bits of the shadow are within the freshness
+ *        window
+ */
+bool DS1631::isStatusFresh()
+{
+    return configShadowValid && ((std::chrono::steady_clock::now() - statusReadAt) < statusFreshness);
+}
+
+/**
+ * \brief forget the shadow of the config register - the next access reads
+ *        the chip
+ */
+void DS1631::InvalidateConfig()
+{
+    configShadowValid = false;
+    statusReadAt = std::chrono::steady_clock::time_point();
+}
+
+/**
+ * \brief read the config register from the chip and refresh the shadow
  * 
  * @return short complete config of DS1631 - see datasheet
  */
 short DS1631::ReadConfig()
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
+    TRACE_DEBUG(i2c_device->getAddress(), "");
     //sudo i2cget -y 1 0x4C 0xac
-    unsigned char buffer[1] = {0};
-    buffer[0] = DS1631_ACCESS_CONFIG;
-    i2c_device->WriteByte(buffer, 1);
+    DS1631_Buffer command, reply;
+    command.push_back(DS1631_ACCESS_CONFIG);
+    reply.resize(1);
     short config = 0;
-    if (i2c_device->ReadByte(buffer, 1))
+    if (i2c_device->WriteRead(command, reply))
+    {
+        config = reply[0];
+        configShadow = config;
+        configShadowValid = true;
+        statusReadAt = std::chrono::steady_clock::now();
+        TRACE_DEBUG(i2c_device->getAddress(), "config: {x}", config);
+    }
+    else
     {
-        config = buffer[0];
-        if (i2c_device->isVerbose())
-            std::cout << "--Config: " << config << std::endl;
+        InvalidateConfig();
     }
 
     return config;
 }
 
+/**
+ * \brief write the config register. The write is skipped if it would not
+ *        change the chip: same setup bits and no THF/TLF cleared which
+ *        may be set. A previous EEPROM cycle is waited for; nothing is
+ *        sent while it does not end - the chip would not take the write.
+ *        Only a change of the EEPROM bits (POL, 1SHOT) starts a cycle of
+ *        its own, which runs on after the call (see isNvmBusy()); flag
+ *        clears and resolution changes are volatile.
+ *        The setup bits of the shadow take the written value, the status
+ *        bits are read again on the next access.
+ * 
+ * \param config new config of DS1631 - see datasheet
+ */
 bool DS1631::WriteConfig(short config)
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    unsigned char buffer[2] = {0};
-    buffer[0] = DS1631_ACCESS_CONFIG;
-	buffer[1] = config;
-    return i2c_device->WriteByte(buffer, 2);
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    short flags = DS1631_CONFIG_TEMP_HIGH_FLAG | DS1631_CONFIG_TEMP_LOW_FLAG;
+    short clears = ~config & flags;
+    bool nothingToClear = (clears == 0) || (isStatusFresh() && !(configShadow & clears));
+    if (configShadowValid && !((config ^ configShadow) & DS1631_CONFIG_SETUP_BITS) && nothingToClear)
+    {
+        TRACE_DEBUG(i2c_device->getAddress(), "config {x} unchanged", config);
+        return true;
+    }
+
+    // an unknown shadow may hide a change of the EEPROM bits
+    bool nvm = !configShadowValid || ((config ^ configShadow) & DS1631_CONFIG_NVM_BITS);
+    if (!WaitForNvm())
+    {
+        InvalidateConfig();
+        return false;
+    }
+    DS1631_Buffer buffer;
+    buffer.push_back(DS1631_ACCESS_CONFIG);
+    buffer.push_back(config);
+    if (!i2c_device->Write(buffer))
+    {
+        InvalidateConfig();
+        return false;
+    }
+    configShadow = config;
+    configShadowValid = true;
+    if (nvm)
+    {
+        StartedNvmWrite();
+    }
+    return true;
+}
+
+/**
+ * \brief note an EEPROM cycle started by a write - NVB is set until it ends
+ */
+void DS1631::StartedNvmWrite()
+{
+    nvmPending = true;
+    nvmDue = std::chrono::steady_clock::now() + NvmWriteTime;
+    statusReadAt = std::chrono::steady_clock::time_point();
+    nvmWrites++;
+}
+
+/**
+ * \brief true while an EEPROM cycle started by this object runs - no bus
+ *        access before the cycle is due to end, one config read after
+ * 
+ */
+bool DS1631::isNvmBusy()
+{
+    if (!nvmPending)
+    {
+        return false;
+    }
+    if (std::chrono::steady_clock::now() < nvmDue)
+    {
+        return true;
+    }
+    short config = CachedConfig(DS1631_CONFIG_NVM_BUSY_FLAG);
+    if (configShadowValid && !(config & DS1631_CONFIG_NVM_BUSY_FLAG))
+    {
+        nvmPending = false;
+    }
+    return nvmPending;
+}
+
+/**
+ * \brief wait for the end of the EEPROM cycle started by this object - the
+ *        chip does not acknowledge EEPROM writes before. Sleeps until the
+ *        cycle is due to end, then confirms with NVB.
+ * 
+ * \return false if NVB stayed set or the sensor did not answer
+ */
+bool DS1631::WaitForNvm()
+{
+    if (!nvmPending)
+    {
+        return true;
+    }
+    std::this_thread::sleep_until(nvmDue);
+    std::chrono::steady_clock::time_point deadline = nvmDue + NvmTimeout;
+    for (;;)
+    {
+        short config = ReadConfig();
+        if (!configShadowValid)
+        {
+            return false;
+        }
+        if (!(config & DS1631_CONFIG_NVM_BUSY_FLAG))
+        {
+            nvmPending = false;
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            TRACE_ERROR(i2c_device->getAddress(), "EEPROM still busy");
+            return false;
+        }
+        std::this_thread::sleep_for(NvmPoll);
+    }
+}
+
+/*!
+ * \brief clear latched THF/TLF flags with a single config write. Only the
+ *        given flags are written as 0 - a flag that latched after the
+ *        config was read is written as 1 and so kept.
+ * 
+ * \param flags DS1631_CONFIG_TEMP_HIGH_FLAG and/or DS1631_CONFIG_TEMP_LOW_FLAG
+ *        as seen in the last config read
+ * \return false if the sensor did not take the write
+ */
+bool DS1631::ClearAlarmFlags(short flags)
+{
+    flags &= (DS1631_CONFIG_TEMP_HIGH_FLAG | DS1631_CONFIG_TEMP_LOW_FLAG);
+    if (flags == 0)
+    {
+        return true;
+    }
+    short config = CachedConfig(DS1631_CONFIG_SETUP_BITS);
+    if (!configShadowValid)
+    {
+        return false;
+    }
+    config |= (DS1631_CONFIG_TEMP_HIGH_FLAG | DS1631_CONFIG_TEMP_LOW_FLAG);
+    return WriteConfig(config & ~flags);
+}
+
+/*!
+ * \brief software power on reset - volatile state of the chip is reset
+ *  sudo i2cset -y 1 0x4C 0x54
+ */
+bool DS1631::SoftwarePOR()
+{
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    DS1631_Buffer command;
+    command.push_back(DS1631_SOFTWARE_POR);
+    InvalidateConfig();
+    converting = false;
+    return i2c_device->Write(command);
+}
+
+/**
+ * \brief split the config register into its fields
+ * 
+ * \param config raw config of DS1631 - see datasheet
+ * \return DS1631_Status decoded fields, valid is set
+ */
+DS1631_Status DS1631::DecodeConfig(short config)
+{
+    DS1631_Status status;
+    status.valid = true;
+    status.config = config;
+    status.conversionDone = DS1631_Config::ConversionDone::Get(config);
+    status.tempHighFlag = DS1631_Config::TempHighFlag::Get(config);
+    status.tempLowFlag = DS1631_Config::TempLowFlag::Get(config);
+    status.nvmBusy = DS1631_Config::NvmBusy::Get(config);
+    status.resolution = DS1631_Config::Resolution::Get(config);
+    // 9 bit take 93.75ms, every further bit doubles the time
+    status.resolutionBits = 9 + status.resolution;
+    status.conversionTime = std::chrono::microseconds(93750 << status.resolution);
+    status.toutPolarityHigh = DS1631_Config::ToutPolarity::Get(config);
+    status.oneShotMode = DS1631_Config::OneShot::Get(config);
+    return status;
+}
+
+/**
+ * \brief all fields of the config register with at most one bus read
+ *        (none if the shadow is within its freshness window)
+ * 
+ * \return DS1631_Status decoded register - valid is false without answer
+ */
+DS1631_Status DS1631::ReadStatus()
+{
+    short config = CachedConfig(DS1631_CONFIG_STATUS_BITS | DS1631_CONFIG_SETUP_BITS);
+    if (!configShadowValid)
+    {
+        return DS1631_Status();
+    }
+    return DecodeConfig(config);
 }
 
 void DS1631::EvalConfig()
 {
-    if (ConfigIsConversionDone())
+    DS1631_Status status = ReadStatus();
+    if (!status.valid)
+    {
+        TRACE_DEBUG(i2c_device->getAddress(), "config not available");
+        return;
+    }
+
+    if (status.conversionDone)
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): Conversion done" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "Conversion done");
     }
     else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): Conversion in progress" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "Conversion in progress");
     }
 
-    if (ConfigIsTempHighFlagSet())
+    if (status.tempHighFlag)
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): HighTemp overflow active" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "HighTemp overflow active");
     }
     else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): HighTemp overflow inactive" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "HighTemp overflow inactive");
     }
 
-    if (ConfigIsTempLowFlagSet())
+    if (status.tempLowFlag)
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): LowTemp overflow active" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "LowTemp overflow active");
     }
     else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): LowTemp overflow inactive" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "LowTemp overflow inactive");
     }
 
-    if (ConfigIsNvMBusy())
+    if (status.nvmBusy)
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): NvM write in progress" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "NvM write in progress");
     }
     else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): NvM write done" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "NvM write done");
     }
 
-	short ResolutionAndTime = ConfigGetResolutionAndConversionTime();
-	if (ResolutionAndTime == DS1631_CONFIG_09BIT_094MS)
-	{
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): accuracy 8Bit, cycle 93.75ms" << std::endl;
+    TRACE_DEBUG(i2c_device->getAddress(), "accuracy {}Bit, cycle {}us", status.resolutionBits, status.conversionTime.count());
+
+    if (status.toutPolarityHigh)
+    {
+        TRACE_DEBUG(i2c_device->getAddress(), "Polarity is HIGH");
     }
-    else if (ResolutionAndTime == DS1631_CONFIG_10BIT_188MS)
+    else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): accuracy 9Bit, cycle 187.5ms" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "Polarity is LOW");
     }
-    else if (ResolutionAndTime == DS1631_CONFIG_11BIT_375MS)
+    if (status.oneShotMode)
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): accuracy 11Bit, cycle 375ms" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "OneShot conversion is active");
     }
-    else if (ResolutionAndTime == DS1631_CONFIG_12BIT_750MS)
+    else
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): accuracy 12Bit, cycle 750ms" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "continuous conversion is active");
     }
+}
 
-    if (ConfigIsToutPolarityHigh())
+/*!
+ * \brief read a trip point register
+ * 
+ * \param command DS1631_ACCESS_TH or DS1631_ACCESS_TL
+ * \param limit register content
+ * \return false if the sensor did not answer
+ */
+bool DS1631::ReadTripPoint(unsigned char command, DS1631_Temperature &limit)
+{
+    int trip = (command == DS1631_ACCESS_TH) ? 0 : 1;
+    DS1631_Buffer pointer, reply;
+    pointer.push_back(command);
+    reply.resize(2);
+    if (!i2c_device->WriteRead(pointer, reply))
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): Polarity is HIGH" << std::endl;
+        tripKnown[trip] = false;
+        return false;
     }
-    else
+    limit = DS1631_Temperature::FromRegister(reply[0], reply[1]);
+    tripShadow[trip] = limit;
+    tripKnown[trip] = true;
+    return true;
+}
+
+/*!
+ * \brief write a trip point register - the chip keeps 12 bits, so the
+ *        limit is rounded to the nearest 1/16°C and reads back unchanged.
+ *        A limit the register already holds is not written again (an
+ *        unknown register is read first - a read does not wear the
+ *        EEPROM). A previous EEPROM cycle is waited for; this one runs on
+ *        after the call. If the previous cycle does not end, nothing is
+ *        sent and the register counts as unknown.
+ * 
+ * \param command DS1631_ACCESS_TH or DS1631_ACCESS_TL
+ * \param limit new limit
+ */
+bool DS1631::WriteTripPoint(unsigned char command, DS1631_Temperature limit)
+{
+    int trip = (command == DS1631_ACCESS_TH) ? 0 : 1;
+    DS1631_Temperature stored = limit.Rounded(12);
+    DS1631_Temperature current;
+    if (!tripKnown[trip])
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): Polarity is LOW" << std::endl;
+        ReadTripPoint(command, current);
     }
-    if (ConfigIs1ShotModeActive())
+    if (tripKnown[trip] && (tripShadow[trip] == stored))
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): OneShot conversion is active" << std::endl;
+        TRACE_DEBUG(i2c_device->getAddress(), "limit {}m°C unchanged", stored.MilliCelsius());
+        nvmWritesSkipped++;
+        return true;
     }
-    else
+
+    if (!WaitForNvm())
     {
-        if (i2c_device->isVerbose())
-            std::cout << "\tconfig(" << i2c_device->getAddress() << "): continuous conversion is active" << std::endl;
+        tripKnown[trip] = false;
+        return false;
     }
+    DS1631_Buffer buffer;
+    buffer.push_back(command);
+    buffer.push_back(stored.Msb());
+    buffer.push_back(stored.Lsb());
+    if (!i2c_device->Write(buffer))
+    {
+        tripKnown[trip] = false;
+        return false;
+    }
+    tripShadow[trip] = stored;
+    tripKnown[trip] = true;
+    StartedNvmWrite();
+    return true;
 }
 
 /*!
  * \brief read the upper temperature limit
  * 
- * \param temperature of upper limit in °C
+ * \param limit upper limit
+ * \return false if the sensor did not answer
  */
-float DS1631::ReadUpperTempTripPoint()
+bool DS1631::ReadUpperTempTripPoint(DS1631_Temperature &limit)
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    //sudo i2cget -y 1 0x4C 0xa1
-    unsigned char buffer[2] = {0};
-    buffer[0] = DS1631_ACCESS_TH;
-    i2c_device->WriteByte(buffer, 1);
-    float templimit = 0;
-    if (i2c_device->ReadByte(buffer, 2))
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    //sudo i2cget -y 1 0x4C 0xa1 w
+    if (!ReadTripPoint(DS1631_ACCESS_TH, limit))
     {
-        ConvertByte2Compl(buffer[0], buffer[1], templimit);
-        if (i2c_device->isVerbose())
-            std::cout << "--UpperLimit: " << std::dec << std::setprecision(2) << templimit << "°C" << std::endl;
+        return false;
     }
+    TRACE_DEBUG(i2c_device->getAddress(), "upper limit: {}m°C", limit.MilliCelsius());
+    return true;
+}
 
-    return templimit;
+/*!
+ * \brief read the upper temperature limit
+ * 
+ * \return temperature of upper limit in °C - NAN if the sensor did not answer
+ */
+float DS1631::ReadUpperTempTripPoint()
+{
+    DS1631_Temperature limit;
+    return ReadUpperTempTripPoint(limit) ? limit.Celsius() : NAN;
 }
 
 /*!
  * \brief write the upper temperature limit
  */
+bool DS1631::WriteUpperTempTripPoint(DS1631_Temperature tempLimit)
+{
+    TRACE_DEBUG(i2c_device->getAddress(), "{}m°C", tempLimit.MilliCelsius());
+    return WriteTripPoint(DS1631_ACCESS_TH, tempLimit);
+}
+
 bool DS1631::WriteUpperTempTripPoint(float tempLimit)
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    //sudo i2cget -y 1 0x4C 0xa1
-    unsigned char buffer[3] = {0};
-     short int_byte, float_byte;
-    ConvertCompl2Byte(tempLimit, int_byte, float_byte);
-    buffer[0] = DS1631_ACCESS_TH;
-    buffer[1] = int_byte;
-    buffer[2] = float_byte;
-    return i2c_device->WriteByte(buffer, 3);
+    return WriteUpperTempTripPoint(DS1631_Temperature::FromCelsius(tempLimit));
 }
 
 /*!
  * \brief read the lower temperature limit
+ * 
+ * \param limit lower limit
+ * \return false if the sensor did not answer
  */
-float DS1631::ReadLowerTempTripPoint()
+bool DS1631::ReadLowerTempTripPoint(DS1631_Temperature &limit)
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    //sudo i2cget -y 1 0x4C 0xa1
-    unsigned char buffer[2] = {0};
-    buffer[0] =  DS1631_ACCESS_TL;
-    i2c_device->WriteByte(buffer, 1);
-    float templimit = 0;
-    if (i2c_device->ReadByte(buffer, 2))
+    TRACE_DEBUG(i2c_device->getAddress(), "");
+    //sudo i2cget -y 1 0x4C 0xa2 w
+    if (!ReadTripPoint(DS1631_ACCESS_TL, limit))
     {
-        ConvertByte2Compl(buffer[0], buffer[1], templimit);
-        if (i2c_device->isVerbose())
-            std::cout << "--LowerLimit: " << std::dec << std::setprecision(2) << templimit << "°C" << std::endl;
+        return false;
     }
-    return templimit;
+    TRACE_DEBUG(i2c_device->getAddress(), "lower limit: {}m°C", limit.MilliCelsius());
+    return true;
+}
+
+/*!
+ * \brief read the lower temperature limit
+ * 
+ * \return temperature of lower limit in °C - NAN if the sensor did not answer
+ */
+float DS1631::ReadLowerTempTripPoint()
+{
+    DS1631_Temperature limit;
+    return ReadLowerTempTripPoint(limit) ? limit.Celsius() : NAN;
 }
 
 /*!
  * \brief write the lower temperature limit
  */
+bool DS1631::WriteLowerTempTripPoint(DS1631_Temperature tempLimit)
+{
+    TRACE_DEBUG(i2c_device->getAddress(), "{}m°C", tempLimit.MilliCelsius());
+    return WriteTripPoint(DS1631_ACCESS_TL, tempLimit);
+}
+
 bool DS1631::WriteLowerTempTripPoint(float tempLimit)
 {
-    if (i2c_device->isVerbose())
-        std::cout << typeid(*this).name() << "::" << __func__ << "(0x" << std::hex << i2c_device->getAddress() << ")" << std::endl;
-    //sudo i2cget -y 1 0x4C 0xa1
-    unsigned char buffer[3] = {0};
-    short int_byte, float_byte;
-    ConvertCompl2Byte(tempLimit, int_byte, float_byte);
-    buffer[0] = DS1631_ACCESS_TL;
-    buffer[1] = int_byte;
-    buffer[2] = float_byte;
-    return i2c_device->WriteByte(buffer, 3);
+    return WriteLowerTempTripPoint(DS1631_Temperature::FromCelsius(tempLimit));
+}
+
+/**************************************
+ * batched sweeps
+ * A batch is transferred as a transaction of the device of its first
+ * sensor: transient errors are retried by its policy, on a scheduled bus
+ * it is queued in its traffic class. Quarantined sensors are left out.
+ **************************************/
+/*!
+ * \brief start the conversion of all given sensors in as few I2C_RDWR
+ *        calls as the kernel allows (one message per sensor)
+ * 
+ * \param bus adapter all sensors are connected to
+ * \param sensors sensors to start - quarantined ones are skipped
+ * \return true if all sensors acknowledged the command
+ */
+bool DS1631::StartConvertAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} sensors", sensors.size());
+
+    unsigned char command[1] = {DS1631_START_CONVERT_T};
+    struct i2c_msg messages[I2C_Bus::MaxMessages];
+    I2C_Interface *devices[I2C_Bus::MaxMessages];
+    DS1631 *batch[I2C_Bus::MaxMessages];
+    bool ret = true;
+
+    size_t next = 0;
+    while (next < sensors.size())
+    {
+        int count = 0;
+        for (; (next < sensors.size()) && (count < I2C_Bus::MaxMessages); next++)
+        {
+            if (!sensors[next]->i2c_device->isAvailable())
+            {
+                ret = false;
+                continue;
+            }
+            batch[count] = sensors[next];
+            sensors[next]->statusReadAt = std::chrono::steady_clock::time_point();
+            messages[count].addr = sensors[next]->i2c_device->getAddress();
+            messages[count].flags = 0;
+            messages[count].len = 1;
+            messages[count].buf = command;
+            devices[count] = sensors[next]->i2c_device;
+            count++;
+        }
+        if ((count > 0) && !devices[0]->TransferBatch(bus, messages, count, devices))
+        {
+            // the kernel stops at the first NACK - start the rest one by one
+            for (int i = 0; i < count; i++)
+            {
+                ret = batch[i]->StartConvert() && ret;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                batch[i]->ScheduleConversion();
+            }
+        }
+    }
+    return ret;
+}
+
+/*!
+ * \brief time the last result of the given sensors is due
+ * 
+ * \param sensors sensors started before
+ * \return latest due time of the pending conversions (epoch if none)
+ */
+std::chrono::steady_clock::time_point DS1631::ConversionDue(std::vector<DS1631 *> const &sensors)
+{
+    std::chrono::steady_clock::time_point due;
+    for (DS1631 *sensor : sensors)
+    {
+        if (sensor->converting && (sensor->conversionDue > due))
+            due = sensor->conversionDue;
+    }
+    return due;
+}
+
+/*!
+ * \brief wait for the conversions of several sensors - one sleep until
+ *        the last is due, then the one-shot sensors confirm DONE
+ * 
+ * \param sensors sensors started before
+ * \return true if all pending conversions finished
+ */
+bool DS1631::WaitForConversionAll(std::vector<DS1631 *> const &sensors)
+{
+    std::this_thread::sleep_until(ConversionDue(sensors));
+    bool ret = true;
+    for (DS1631 *sensor : sensors)
+    {
+        ret = sensor->WaitForConversion() && ret;
+    }
+    return ret;
+}
+
+/*!
+ * \brief check the DONE flag of the pending one-shot conversions once,
+ *        without waiting - the caller spends the time between the checks,
+ *        so a bus worker running the check stays free for other traffic.
+ *        A sensor is given up like in PollConversionDone(): one more
+ *        conversion time after it was due.
+ * 
+ * \param sensors sensors started before
+ * \param retry time the next check is due - epoch if none is pending
+ * \return false if a sensor did not answer or did not finish in time
+ */
+bool DS1631::CheckConversionAll(std::vector<DS1631 *> const &sensors, std::chrono::steady_clock::time_point &retry)
+{
+    retry = std::chrono::steady_clock::time_point();
+    bool ret = true;
+    for (DS1631 *sensor : sensors)
+    {
+        if (!sensor->converting || !(sensor->CachedConfig(DS1631_CONFIG_SETUP_BITS) & DS1631_CONFIG_1SHOT_CONVERSION))
+        {
+            continue;
+        }
+        std::chrono::microseconds duration = sensor->ConversionTime();
+        std::chrono::steady_clock::time_point next = sensor->conversionDue;
+        if (std::chrono::steady_clock::now() >= next)
+        {
+            short config = sensor->ReadConfig();
+            if (!sensor->configShadowValid)
+            {
+                ret = false;
+                continue;
+            }
+            if (config & DS1631_CONFIG_CONVERSTION_DONE_FLAG)
+            {
+                sensor->converting = false;
+                continue;
+            }
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= sensor->conversionDue + duration)
+            {
+                TRACE_ERROR(sensor->i2c_device->getAddress(), "conversion not done after {}us", (duration * 2).count());
+                ret = false;
+                continue;
+            }
+            next = now + std::max(duration / 16, std::chrono::microseconds(2000));
+        }
+        if ((retry == std::chrono::steady_clock::time_point()) || (next < retry))
+            retry = next;
+    }
+    return ret;
+}
+
+/*!
+ * \brief read the temperature of all given sensors. Pointer write and
+ *        2 byte read of every sensor are collected into one I2C_RDWR call
+ *        (split only at the kernel message limit) and decoded afterwards.
+ * 
+ * \param bus adapter all sensors are connected to
+ * \param sensors sensors to read
+ * \param readings one entry per sensor, in the order of sensors -
+ *        quarantined sensors are skipped and marked invalid
+ * \return true if all sensors delivered a temperature
+ */
+bool DS1631::ReadTemperatureAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors, std::vector<DS1631_Reading> &readings)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} sensors", sensors.size());
+
+    static const int MessagesPerSensor = 2;
+    static const int SensorsPerTransfer = I2C_Bus::MaxMessages / MessagesPerSensor;
+
+    unsigned char command[1] = {DS1631_READ_TEMPERATURE};
+    unsigned char buffer[SensorsPerTransfer][2];
+    struct i2c_msg messages[SensorsPerTransfer * MessagesPerSensor];
+    I2C_Interface *devices[SensorsPerTransfer * MessagesPerSensor];
+    size_t index[SensorsPerTransfer];
+    bool ret = true;
+
+    readings.resize(sensors.size());
+    size_t next = 0;
+    while (next < sensors.size())
+    {
+        int count = 0;
+        for (; (next < sensors.size()) && (count < SensorsPerTransfer); next++)
+        {
+            DS1631_Reading &reading = readings[next];
+            reading.address = sensors[next]->i2c_device->getAddress();
+            reading.valid = false;
+            reading.value = DS1631_Temperature();
+            if (!sensors[next]->i2c_device->isAvailable())
+            {
+                ret = false;
+                continue;
+            }
+            index[count] = next;
+            int addr = reading.address;
+            messages[2 * count].addr = addr;
+            messages[2 * count].flags = 0;
+            messages[2 * count].len = 1;
+            messages[2 * count].buf = command;
+            messages[2 * count + 1].addr = addr;
+            messages[2 * count + 1].flags = I2C_M_RD;
+            messages[2 * count + 1].len = 2;
+            messages[2 * count + 1].buf = buffer[count];
+            devices[2 * count] = sensors[next]->i2c_device;
+            devices[2 * count + 1] = sensors[next]->i2c_device;
+            count++;
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+
+        bool batchOk = devices[0]->TransferBatch(bus, messages, count * MessagesPerSensor, devices);
+        for (int j = 0; j < count; j++)
+        {
+            DS1631 *sensor = sensors[index[j]];
+            DS1631_Reading &reading = readings[index[j]];
+            if (batchOk)
+            {
+                reading.valid = true;
+            }
+            else
+            {
+                // the kernel stops at the first NACK - fall back to single reads
+                reading.valid = sensor->i2c_device->WriteRead(command, 1, buffer[j], 2);
+            }
+            if (reading.valid)
+            {
+                reading.value = DS1631_Temperature::FromRegister(buffer[j][0], buffer[j][1]);
+            }
+            ret = reading.valid && ret;
+        }
+    }
+    return ret;
+}
+
+/*!
+ * \brief read the config register of all given sensors - pointer write
+ *        and 1 byte read of every sensor in one I2C_RDWR call (split only
+ *        at the kernel message limit). The shadows are refreshed.
+ * 
+ * \param bus adapter all sensors are connected to
+ * \param sensors sensors to read
+ * \param status one entry per sensor, in the order of sensors - invalid
+ *        for quarantined or silent sensors
+ * \return true if all sensors delivered their config
+ */
+bool DS1631::ReadStatusAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors, std::vector<DS1631_Status> &status)
+{
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} sensors", sensors.size());
+
+    static const int MessagesPerSensor = 2;
+    static const int SensorsPerTransfer = I2C_Bus::MaxMessages / MessagesPerSensor;
+
+    unsigned char command[1] = {DS1631_ACCESS_CONFIG};
+    unsigned char buffer[SensorsPerTransfer][1];
+    struct i2c_msg messages[SensorsPerTransfer * MessagesPerSensor];
+    I2C_Interface *devices[SensorsPerTransfer * MessagesPerSensor];
+    size_t index[SensorsPerTransfer];
+    bool ret = true;
+
+    status.resize(sensors.size());
+    size_t next = 0;
+    while (next < sensors.size())
+    {
+        int count = 0;
+        for (; (next < sensors.size()) && (count < SensorsPerTransfer); next++)
+        {
+            status[next] = DS1631_Status();
+            if (!sensors[next]->i2c_device->isAvailable())
+            {
+                ret = false;
+                continue;
+            }
+            index[count] = next;
+            int addr = sensors[next]->i2c_device->getAddress();
+            messages[2 * count].addr = addr;
+            messages[2 * count].flags = 0;
+            messages[2 * count].len = 1;
+            messages[2 * count].buf = command;
+            messages[2 * count + 1].addr = addr;
+            messages[2 * count + 1].flags = I2C_M_RD;
+            messages[2 * count + 1].len = 1;
+            messages[2 * count + 1].buf = buffer[count];
+            devices[2 * count] = sensors[next]->i2c_device;
+            devices[2 * count + 1] = sensors[next]->i2c_device;
+            count++;
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+
+        bool batchOk = devices[0]->TransferBatch(bus, messages, count * MessagesPerSensor, devices);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (int j = 0; j < count; j++)
+        {
+            DS1631 *sensor = sensors[index[j]];
+            if (batchOk)
+            {
+                sensor->configShadow = buffer[j][0];
+                sensor->configShadowValid = true;
+                sensor->statusReadAt = now;
+            }
+            else
+            {
+                // the kernel stops at the first NACK - fall back to single reads
+                sensor->ReadConfig();
+            }
+            if (sensor->configShadowValid)
+            {
+                status[index[j]] = DecodeConfig(sensor->configShadow);
+            }
+            ret = status[index[j]].valid && ret;
+        }
+    }
+    return ret;
 }
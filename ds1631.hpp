@@ -9,7 +9,16 @@
  * MIT license - see license file
  */
 
+#pragma once
+
 #include "I2C_Device.hpp"
+#include "ds1631_temperature.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <vector>
 
 /* command line commands
 set up continuous measurement
@@ -23,25 +32,278 @@ sudo i2cget -y 1 0x4C 0xaa
 
  */
 
+// defines from datasheet
+#define DS1631_START_CONVERT_T 0x51
+#define DS1631_STOP_CONVERT_T 0x22
+#define DS1631_READ_TEMPERATURE 0xAA
+#define DS1631_ACCESS_TH 0xA1
+#define DS1631_ACCESS_TL 0xA2
+#define DS1631_ACCESS_CONFIG 0xAC
+#define DS1631_SOFTWARE_POR 0x54
+
+#define DS1631_CONFIG_CONVERSTION_DONE_FLAG (1 << 7)
+#define DS1631_CONFIG_CONVERSTION_IN_PROGRESS 0
+#define DS1631_CONFIG_CONVERSTION_COMPLETE 1
+#define DS1631_CONFIG_TEMP_HIGH_FLAG (1 << 6)
+#define DS1631_CONFIG_TEMP_HIGH_OVERFLOW_INACTIVE 0
+#define DS1631_CONFIG_TEMP_HIGH_OVERFLOW_ACTIVE 1
+#define DS1631_CONFIG_TEMP_LOW_FLAG (1 << 5)
+#define DS1631_CONFIG_TEMP_LOW_OVERFLOW_INACTIVE 0
+#define DS1631_CONFIG_TEMP_LOW_OVERFLOW_ACTIVE 1
+#define DS1631_CONFIG_NVM_BUSY_FLAG (1 << 4)
+#define DS1631_CONFIG_NVM_NOT_BUSY 0
+#define DS1631_CONFIG_NVM_BUSY 1
+#define DS1631_CONFIG_RESOLUTION_BIT1 (1 << 3)
+#define DS1631_CONFIG_RESOLUTION_BIT0 (1 << 2)
+#define DS1631_CONFIG_09BIT_094MS 0
+#define DS1631_CONFIG_10BIT_188MS 1
+#define DS1631_CONFIG_11BIT_375MS 2
+#define DS1631_CONFIG_12BIT_750MS 3
+#define DS1631_CONFIG_TOUT_POLARITY (1 << 1)
+#define DS1631_CONFIG_ACTIVE_LOW 0
+#define DS1631_CONFIG_ACTIVE_HIGH 1
+#define DS1631_CONFIG_1SHOT_CONVERSION (1 << 0)
+#define DS1631_CONFIG_CONTINUOUS_MODE 0
+#define DS1631_CONFIG_ONE_SHOT_MODE 1
+// status bits changed by the chip itself
+#define DS1631_CONFIG_STATUS_BITS (DS1631_CONFIG_CONVERSTION_DONE_FLAG | DS1631_CONFIG_TEMP_HIGH_FLAG | \
+                                   DS1631_CONFIG_TEMP_LOW_FLAG | DS1631_CONFIG_NVM_BUSY_FLAG)
+// setup bits only changed by a config write
+#define DS1631_CONFIG_SETUP_BITS (DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0 | \
+                                  DS1631_CONFIG_TOUT_POLARITY | DS1631_CONFIG_1SHOT_CONVERSION)
+// setup bits kept in EEPROM - R1/R0 and the flags are volatile
+#define DS1631_CONFIG_NVM_BITS (DS1631_CONFIG_TOUT_POLARITY | DS1631_CONFIG_1SHOT_CONVERSION)
+
+/**
+ * @brief position of the lowest set bit of a mask
+ * 
+ */
+constexpr int DS1631_LowestBit(unsigned mask)
+{
+    return (mask & 1) ? 0 : 1 + DS1631_LowestBit(mask >> 1);
+}
+
+/**
+ * @brief descriptor of a field of the config register - a contiguous run
+ *        of bits given by one of the DS1631_CONFIG_* masks. Writable is
+ *        false for the bits which only the chip changes.
+ * 
+ */
+template <unsigned char Mask, bool Writable>
+struct DS1631_Field
+{
+    static_assert(Mask != 0, "field without bits");
+    static_assert((((Mask >> DS1631_LowestBit(Mask)) + 1) & (Mask >> DS1631_LowestBit(Mask))) == 0,
+                  "bits of a field have to be contiguous");
+
+    static constexpr unsigned char mask = Mask;
+    static constexpr int shift = DS1631_LowestBit(Mask);
+    static constexpr unsigned max = Mask >> DS1631_LowestBit(Mask);
+    static constexpr bool writable = Writable;
+
+    static constexpr unsigned Get(short config){return (config & Mask) >> shift;}
+    static constexpr short Put(short config, unsigned value){return (config & ~Mask) | ((value << shift) & Mask);}
+};
+
+template <unsigned char Mask, bool Writable> constexpr unsigned char DS1631_Field<Mask, Writable>::mask;
+template <unsigned char Mask, bool Writable> constexpr int DS1631_Field<Mask, Writable>::shift;
+template <unsigned char Mask, bool Writable> constexpr unsigned DS1631_Field<Mask, Writable>::max;
+template <unsigned char Mask, bool Writable> constexpr bool DS1631_Field<Mask, Writable>::writable;
+
+/**
+ * @brief fields of the config register
+ * 
+ */
+namespace DS1631_Config
+{
+typedef DS1631_Field<DS1631_CONFIG_CONVERSTION_DONE_FLAG, false> ConversionDone;
+typedef DS1631_Field<DS1631_CONFIG_TEMP_HIGH_FLAG, true> TempHighFlag; // can only be cleared
+typedef DS1631_Field<DS1631_CONFIG_TEMP_LOW_FLAG, true> TempLowFlag;   // can only be cleared
+typedef DS1631_Field<DS1631_CONFIG_NVM_BUSY_FLAG, false> NvmBusy;
+typedef DS1631_Field<DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0, true> Resolution;
+typedef DS1631_Field<DS1631_CONFIG_TOUT_POLARITY, true> ToutPolarity;
+typedef DS1631_Field<DS1631_CONFIG_1SHOT_CONVERSION, true> OneShot;
+
+// the fields cover the register without overlap
+static_assert((ConversionDone::mask + TempHighFlag::mask + TempLowFlag::mask + NvmBusy::mask +
+               Resolution::mask + ToutPolarity::mask + OneShot::mask) == 0xFF,
+              "config fields overlap or leave bits out");
+static_assert((ConversionDone::mask | TempHighFlag::mask | TempLowFlag::mask | NvmBusy::mask |
+               Resolution::mask | ToutPolarity::mask | OneShot::mask) == 0xFF,
+              "config fields overlap or leave bits out");
+static_assert(Resolution::max == DS1631_CONFIG_12BIT_750MS, "resolution field does not match its values");
+}
+
+/**
+ * @brief transfer buffer of a DS1631 transaction: command byte and at most
+ *        two data bytes
+ * 
+ */
+typedef I2C_Buffer<3> DS1631_Buffer;
+
+/**
+ * @brief result of one temperature read - valid is false (and Celsius()
+ *        NAN) when the sensor did not deliver data, so a failed read can
+ *        not be mistaken for 0°C
+ * 
+ */
+struct DS1631_Reading
+{
+    int address;
+    bool valid;
+    DS1631_Temperature value; // register content - exact, integer only
+
+    // float only on demand - reading a sample costs no float conversion
+    float Celsius() const {return valid ? value.Celsius() : NAN;}
+};
+
+/**
+ * @brief decoded config register - all fields come from one read, so the
+ *        flags belong to the same instant. valid is false if the sensor
+ *        did not answer (all other fields are 0 then).
+ * 
+ */
+struct DS1631_Status
+{
+    bool valid;
+    short config;                     // raw register
+    bool conversionDone;
+    bool tempHighFlag;
+    bool tempLowFlag;
+    bool nvmBusy;
+    short resolution;                 // DS1631_CONFIG_09BIT_094MS ... DS1631_CONFIG_12BIT_750MS
+    int resolutionBits;               // 9 ... 12
+    std::chrono::microseconds conversionTime;
+    bool toutPolarityHigh;
+    bool oneShotMode;
+};
+
 class DS1631
 {
 private:
     I2C_Interface* i2c_device;
 
+    /**
+     * @brief shadow of the config register. The setup bits stay valid
+     *        until the next config write or POR, the status bits only for
+     *        statusFreshness after the last read. Not synchronised - the
+     *        config of a sensor is accessed by one thread at a time.
+     *
+     */
+    short configShadow;
+    bool configShadowValid;
+    std::chrono::steady_clock::time_point statusReadAt;
+    std::chrono::microseconds statusFreshness;
+
+    /**
+     * @brief conversion started by this object - in one-shot mode until
+     *        DONE was seen, in continuous mode until it is stopped
+     *
+     */
+    bool converting;
+    std::chrono::steady_clock::time_point conversionDue;
+
+    /**
+     * @brief EEPROM registers: last written or read TH (0) and TL (1), and
+     *        the write cycle running in the chip (NVB) after a write
+     *
+     */
+    DS1631_Temperature tripShadow[2];
+    bool tripKnown[2];
+    bool nvmPending;
+    std::chrono::steady_clock::time_point nvmDue;
+    unsigned long nvmWrites;
+    unsigned long nvmWritesSkipped;
+
 public:
-    DS1631(I2C_Device* i2c_dev);
+    static const std::chrono::microseconds DefaultStatusFreshness;
+    static const std::chrono::microseconds NvmWriteTime;
+
+    /**
+     * @brief collects changes of config fields and applies them with one
+     *        read-modify-write; nothing is written if no field changes.
+     *        sensor.Config().Set<DS1631_Config::Resolution>(DS1631_CONFIG_09BIT_094MS)
+     *                       .Set<DS1631_Config::OneShot>(1).Commit();
+     * 
+     */
+    class ConfigTransaction
+    {
+    public:
+        ConfigTransaction(DS1631 &ds1631) : sensor(ds1631), mask(0), value(0), rangeError(false){}
+
+        template <class Field>
+        ConfigTransaction &Set(unsigned fieldValue)
+        {
+            static_assert(Field::writable, "field is read only");
+            if (fieldValue > Field::max)
+            {
+                rangeError = true;
+            }
+            mask |= Field::mask;
+            value = Field::Put(value, fieldValue);
+            return *this;
+        }
+
+        bool Commit();
+
+    private:
+        DS1631 &sensor;
+        unsigned char mask;   // fields to change
+        short value;          // new values of these fields
+        bool rangeError;
+    };
+
+    DS1631(I2C_Interface* i2c_dev);
     ~DS1631();
 
+    int getAddress(){return i2c_device->getAddress();}
+
     bool StartConvert();
     bool StopConvert();
     float ReadTemperature();
+    DS1631_Reading Read();
+    DS1631_Reading ReadFresh();
+    bool WaitForConversion();
+    std::chrono::microseconds ConversionTime();
+    std::chrono::steady_clock::time_point getConversionDue(){return conversionDue;}
+    std::chrono::steady_clock::time_point ConversionFinished(std::chrono::steady_clock::time_point at);
+    bool isConverting(){return converting;}
     short ReadConfig();
+    DS1631_Status ReadStatus();
+    static DS1631_Status DecodeConfig(short config);
     void EvalConfig();
     bool WriteConfig(short config);
+    ConfigTransaction Config(){return ConfigTransaction(*this);}
+    bool ClearAlarmFlags(short flags);
+    bool isNvmBusy();
+    bool WaitForNvm();
+    unsigned long getNvmWrites(){return nvmWrites;}
+    unsigned long getNvmWritesSkipped(){return nvmWritesSkipped;}
+    bool SoftwarePOR();
+    void InvalidateConfig();
+    void SetStatusFreshness(std::chrono::microseconds freshness){statusFreshness = freshness;}
+    std::chrono::microseconds getStatusFreshness(){return statusFreshness;}
     float ReadUpperTempTripPoint();
+    bool ReadUpperTempTripPoint(DS1631_Temperature &limit);
     bool WriteUpperTempTripPoint(float tempLimit);
+    bool WriteUpperTempTripPoint(DS1631_Temperature tempLimit);
     float ReadLowerTempTripPoint();
+    bool ReadLowerTempTripPoint(DS1631_Temperature &limit);
     bool WriteLowerTempTripPoint(float tempLimit);
+    bool WriteLowerTempTripPoint(DS1631_Temperature tempLimit);
+
+    // asynchronous access - executed by the worker of the bus
+    std::future<bool> StartConvertAsync();
+    std::future<float> ReadTemperatureAsync();
+    void ReadTemperatureAsync(std::function<void(bool, float)> done);
+
+    // batched access to several sensors on one bus
+    static bool StartConvertAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors);
+    static std::chrono::steady_clock::time_point ConversionDue(std::vector<DS1631 *> const &sensors);
+    static bool WaitForConversionAll(std::vector<DS1631 *> const &sensors);
+    static bool CheckConversionAll(std::vector<DS1631 *> const &sensors, std::chrono::steady_clock::time_point &retry);
+    static bool ReadTemperatureAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors, std::vector<DS1631_Reading> &readings);
+    static bool ReadStatusAll(I2C_Bus &bus, std::vector<DS1631 *> const &sensors, std::vector<DS1631_Status> &status);
 
     // config read
     bool ConfigIsConversionDone();
@@ -62,6 +324,11 @@ public:
     bool ConfigSetResolutionAndConversionTime(short ResolutionAndConverstionTime);
 
 protected:
-    void ConvertCompl2Byte(const float &complement, short& int_byte, short& float_byte);
-    void ConvertByte2Compl(const short &int_byte, const short &float_byte, float& complement);
+    short CachedConfig(short bits);
+    bool isStatusFresh();
+    void StartedNvmWrite();
+    void ScheduleConversion();
+    bool PollConversionDone();
+    bool ReadTripPoint(unsigned char command, DS1631_Temperature &limit);
+    bool WriteTripPoint(unsigned char command, DS1631_Temperature limit);
 };
\ No newline at end of file
@@ -0,0 +1,243 @@
+/**
+ * @file ds1631_adaptive.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief sampling policy of a DS1631 which follows the dynamics of the
+ *        signal - slow and coarse while the temperature is flat, fast and
+ *        fine when it changes or approaches a trip point
+ * @version 0.1
+ * @date 2019-06-17
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ds1631_adaptive.hpp"
+
+#define TRACE_COMPONENT "DS1631_Adaptive"
+#include "tracer.hpp"
+
+// full resolution while the signal moves
+static const short FastResolution = DS1631_CONFIG_12BIT_750MS;
+
+const DS1631_AdaptiveSettings DS1631_Adaptive::DefaultSettings = {
+    std::chrono::milliseconds(1000),  // fastInterval
+    std::chrono::milliseconds(60000), // slowInterval
+    0.01f,                            // flatRate: 0.6°C per minute
+    2.0f,                             // tripMargin
+    5,                                // flatSamples
+    DS1631_CONFIG_10BIT_188MS,        // slowResolution: 0.25°C steps
+    std::chrono::milliseconds(60000)  // resolutionHold: at most one resolution change pair per minute
+};
+
+/**
+ * @brief take over a sensor - it is switched to one-shot mode at full
+ *        resolution, so it only converts when a sample is due. A sensor
+ *        already set up that way is not written (1SHOT is EEPROM).
+ *
+ * @param ds1631 sensor - has to live as long as the policy
+ * @param policy limits of the policy
+ */
+DS1631_Adaptive::DS1631_Adaptive(DS1631 &ds1631, DS1631_AdaptiveSettings const &policy)
+    : sensor(ds1631), settings(policy), upperTrip(NAN), lowerTrip(NAN), fast(true), havePrevious(false),
+      rate(0), flatCount(0), interval(policy.fastInterval)
+{
+    report = DS1631_AdaptiveReport();
+    if (!sensor.ConfigIs1ShotModeActive() || (sensor.ConfigGetResolutionAndConversionTime() != FastResolution))
+    {
+        sensor.Config().Set<DS1631_Config::OneShot>(1).Set<DS1631_Config::Resolution>(FastResolution).Commit();
+    }
+    RefreshTripPoints();
+}
+
+/**
+ * @brief Destroy the policy - the sensor keeps its last configuration
+ *
+ */
+DS1631_Adaptive::~DS1631_Adaptive()
+{
+}
+
+/**
+ * @brief read TH and TL again, e.g. after they were changed
+ *
+ * @return false if the sensor did not deliver them
+ */
+bool DS1631_Adaptive::RefreshTripPoints()
+{
+    upperTrip = sensor.ReadUpperTempTripPoint();
+    lowerTrip = sensor.ReadLowerTempTripPoint();
+    return !std::isnan(upperTrip) && !std::isnan(lowerTrip);
+}
+
+/**
+ * @brief change the resolution - deferred to the next sample while the
+ *        EEPROM of the chip is still busy with the previous write. Full
+ *        resolution is applied at once, the drop to slowResolution only
+ *        after resolutionHold at full resolution, so a signal near the
+ *        flat limit changes the resolution at most twice per hold time.
+ *
+ * @param wanted DS1631_CONFIG_09BIT_094MS ... DS1631_CONFIG_12BIT_750MS
+ * @return true if the sensor runs at the wanted resolution
+ */
+bool DS1631_Adaptive::ApplyResolution(short wanted)
+{
+    if (sensor.ConfigGetResolutionAndConversionTime() == wanted)
+    {
+        return true;
+    }
+    if (sensor.isNvmBusy())
+    {
+        return false;
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if ((wanted != FastResolution) && (report.resolutionChanges > 0) && ((now - resolutionChanged) < settings.resolutionHold))
+    {
+        return false;
+    }
+    if (!sensor.Config().Set<DS1631_Config::Resolution>(wanted).Commit())
+    {
+        return false;
+    }
+    report.resolutionChanges++;
+    resolutionChanged = now;
+    TRACE_INFO(TRACE_NO_ADDRESS, "resolution {} bit", 9 + wanted);
+    return true;
+}
+
+/**
+ * @brief true if the temperature moves faster than flatRate or is within
+ *        tripMargin of TH or TL
+ *
+ */
+bool DS1631_Adaptive::isDynamic(float temperature)
+{
+    if (rate > settings.flatRate)
+    {
+        return true;
+    }
+    if (!std::isnan(upperTrip) && (std::fabs(upperTrip - temperature) < settings.tripMargin))
+    {
+        return true;
+    }
+    if (!std::isnan(lowerTrip) && (std::fabs(temperature - lowerTrip) < settings.tripMargin))
+    {
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief take one sample and plan the next one. A moving signal switches
+ *        to 12 bit every fastInterval at once; after flatSamples flat
+ *        samples the resolution drops to slowResolution and the interval
+ *        doubles with every further flat sample up to slowInterval.
+ *
+ * @return DS1631_Reading reading of the sensor
+ */
+DS1631_Reading DS1631_Adaptive::Sample()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (report.samples == 0)
+    {
+        started = start;
+    }
+
+    std::chrono::microseconds conversion = sensor.ConversionTime();
+    DS1631_Reading reading = sensor.ReadFresh();
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    // the conversion is slept through - the rest of the call is bus traffic
+    std::chrono::microseconds busy = std::chrono::duration_cast<std::chrono::microseconds>(now - start) - conversion;
+    report.busTime += std::max(busy, std::chrono::microseconds(0));
+    report.conversionTime += conversion;
+    report.samples++;
+
+    if (reading.valid)
+    {
+        // both samples at the coarse resolution - otherwise the quantization
+        // step of a resolution change counts as a temperature change
+        DS1631_Temperature current = reading.value.Rounded(9 + settings.slowResolution);
+        if (havePrevious)
+        {
+            double seconds = std::chrono::duration<double>(now - previousAt).count();
+            if (seconds > 0)
+            {
+                float momentary = std::fabs(static_cast<float>(current - previous) / DS1631_Temperature::One) / seconds;
+                rate = (rate + momentary) / 2;
+            }
+        }
+        havePrevious = true;
+        previous = current;
+        previousAt = now;
+
+        if (isDynamic(reading.value.Celsius()))
+        {
+            flatCount = 0;
+            fast = true;
+            interval = settings.fastInterval;
+        }
+        else if (++flatCount >= settings.flatSamples)
+        {
+            fast = false;
+            interval = std::min(interval * 2, settings.slowInterval);
+        }
+    }
+    else
+    {
+        // no data - stay attentive
+        fast = true;
+        interval = settings.fastInterval;
+    }
+
+    std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+    ApplyResolution(fast ? FastResolution : settings.slowResolution);
+    report.busTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - before);
+
+    TRACE_DEBUG(reading.address, "{}m°C rate {}°C/s next in {}ms", reading.value.MilliCelsius(), rate, interval.count());
+    nextSample = start + interval;
+    return reading;
+}
+
+/**
+ * @brief compare with sampling every fastInterval at 12 bit for the same
+ *        time; the bus time of the skipped samples is estimated from the
+ *        average bus time of the samples taken
+ *
+ * @return DS1631_AdaptiveReport
+ */
+DS1631_AdaptiveReport DS1631_Adaptive::Report()
+{
+    DS1631_AdaptiveReport result = report;
+    if (result.samples == 0)
+    {
+        return result;
+    }
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - started;
+    result.baselineSamples = 1 + elapsed / settings.fastInterval;
+
+    std::chrono::microseconds perSample = result.busTime / result.samples;
+    std::chrono::microseconds baselineBus = perSample * result.baselineSamples;
+    std::chrono::microseconds baselineConversion = DS1631::DecodeConfig(FastResolution << 2).conversionTime * result.baselineSamples;
+    result.busTimeSaved = std::max(baselineBus - result.busTime, std::chrono::microseconds(0));
+    result.conversionTimeSaved = std::max(baselineConversion - result.conversionTime, std::chrono::microseconds(0));
+    return result;
+}
+
+/**
+ * @brief print the report
+ *
+ * @param out stream to print to
+ */
+void DS1631_Adaptive::Print(std::ostream &out)
+{
+    DS1631_AdaptiveReport result = Report();
+    out << std::dec << "samples=" << result.samples << " (fixed rate " << result.baselineSamples << ")"
+        << " resolution changes=" << result.resolutionChanges
+        << " bus time=" << result.busTime.count() << "us saved=" << result.busTimeSaved.count() << "us"
+        << " conversion time=" << result.conversionTime.count() / 1000 << "ms saved="
+        << result.conversionTimeSaved.count() / 1000 << "ms"
+        << (fast ? " fast" : " slow") << std::endl;
+}
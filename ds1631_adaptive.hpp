@@ -0,0 +1,93 @@
+/**
+ * @file ds1631_adaptive.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief sampling policy of a DS1631 which follows the dynamics of the
+ *        signal - slow and coarse while the temperature is flat, fast and
+ *        fine when it changes or approaches a trip point
+ * @version 0.1
+ * @date 2019-06-17
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "ds1631.hpp"
+
+#include <chrono>
+#include <ostream>
+
+/**
+ * @brief limits of the adaptive policy
+ *
+ */
+struct DS1631_AdaptiveSettings
+{
+    std::chrono::milliseconds fastInterval; // sampling interval while the signal moves
+    std::chrono::milliseconds slowInterval; // longest interval while it is flat
+    float flatRate;                         // °C/s below which the signal counts as flat
+    float tripMargin;                       // °C distance to TH/TL which forces fast sampling
+    int flatSamples;                        // flat samples in a row before slowing down
+    short slowResolution;                   // DS1631_CONFIG_09BIT_094MS or DS1631_CONFIG_10BIT_188MS
+    std::chrono::milliseconds resolutionHold; // least time at full resolution before dropping to slowResolution
+};
+
+/**
+ * @brief what the policy did compared to sampling every fastInterval at
+ *        12 bit
+ *
+ */
+struct DS1631_AdaptiveReport
+{
+    unsigned long samples;
+    unsigned long baselineSamples;              // fixed rate samples in the same time
+    unsigned long resolutionChanges;
+    std::chrono::microseconds busTime;          // spent by the policy
+    std::chrono::microseconds busTimeSaved;     // estimated from the average per sample
+    std::chrono::microseconds conversionTime;   // spent by the sensor
+    std::chrono::microseconds conversionTimeSaved;
+};
+
+class DS1631_Adaptive
+{
+public:
+    static const DS1631_AdaptiveSettings DefaultSettings;
+
+    DS1631_Adaptive(DS1631 &ds1631, DS1631_AdaptiveSettings const &policy = DefaultSettings);
+    ~DS1631_Adaptive();
+
+    DS1631_Reading Sample();
+    bool RefreshTripPoints();
+
+    std::chrono::steady_clock::time_point NextSample(){return nextSample;}
+    bool isFast(){return fast;}
+    float getRate(){return rate;}
+    DS1631_AdaptiveReport Report();
+    void Print(std::ostream &out);
+
+private:
+    bool ApplyResolution(short wanted);
+    bool isDynamic(float temperature);
+
+    DS1631 &sensor;
+    DS1631_AdaptiveSettings settings;
+
+    float upperTrip;
+    float lowerTrip;
+
+    // signal state
+    bool fast;
+    bool havePrevious;
+    DS1631_Temperature previous; // rounded to slowResolution
+    std::chrono::steady_clock::time_point previousAt;
+    float rate;       // smoothed |dT/dt| in °C/s
+    int flatCount;
+    std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point nextSample;
+    std::chrono::steady_clock::time_point resolutionChanged;
+
+    // accounting
+    std::chrono::steady_clock::time_point started;
+    DS1631_AdaptiveReport report;
+};
@@ -0,0 +1,246 @@
+/**
+ * @file ds1631_alarm.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief alarm monitoring of DS1631 sensors by their hardware thermostat -
+ *        only the latched THF/TLF flags are polled, the temperature is
+ *        read when a flag tripped
+ * @version 0.1
+ * @date 2019-06-18
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include "ds1631_alarm.hpp"
+
+#define TRACE_COMPONENT "DS1631_Alarm"
+#include "tracer.hpp"
+
+/**
+ * @brief Construct a new monitor without sensors
+ *
+ */
+DS1631_AlarmMonitor::DS1631_AlarmMonitor()
+{
+    stats = DS1631_AlarmStats();
+}
+
+/**
+ * @brief Destroy the monitor - the thermostats stay armed
+ *
+ */
+DS1631_AlarmMonitor::~DS1631_AlarmMonitor()
+{
+}
+
+/**
+ * @brief add a sensor to the polls - its trip points are read once
+ *
+ * @param bus adapter the sensor is connected to
+ * @param sensor sensor - has to live as long as the monitor
+ */
+void DS1631_AlarmMonitor::AddSensor(I2C_Bus &bus, DS1631 *sensor)
+{
+    SensorState state = SensorState();
+    sensor->ReadUpperTempTripPoint(state.upper);
+    sensor->ReadLowerTempTripPoint(state.lower);
+
+    for (BusGroup &group : groups)
+    {
+        if (group.bus == &bus)
+        {
+            group.sensors.push_back(sensor);
+            group.state.push_back(state);
+            return;
+        }
+    }
+    groups.push_back(BusGroup());
+    groups.back().bus = &bus;
+    groups.back().sensors.push_back(sensor);
+    groups.back().state.push_back(state);
+}
+
+/**
+ * @brief alarm state of a sensor added to the polls
+ *
+ * @return nullptr if the sensor was not added
+ */
+DS1631_AlarmMonitor::SensorState *DS1631_AlarmMonitor::Find(DS1631 *sensor)
+{
+    for (BusGroup &group : groups)
+    {
+        for (size_t i = 0; i < group.sensors.size(); i++)
+        {
+            if (group.sensors[i] == sensor)
+                return &group.state[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief clear the flags of a reported alarm once the temperature is back
+ *        between the trip points - while it is beyond, the chip latches
+ *        them again after every conversion and a clear is wasted bus
+ *        traffic
+ *
+ * @return true if the alarm is over
+ */
+bool DS1631_AlarmMonitor::Settle(DS1631 *sensor, SensorState &state, DS1631_Reading const &reading)
+{
+    if (!reading.valid)
+    {
+        return false;
+    }
+    if ((state.high && (reading.value >= state.upper)) || (state.low && (reading.value <= state.lower)))
+    {
+        return false;
+    }
+    short seen = (state.high ? DS1631_CONFIG_TEMP_HIGH_FLAG : 0) | (state.low ? DS1631_CONFIG_TEMP_LOW_FLAG : 0);
+    if (!sensor->ClearAlarmFlags(seen))
+    {
+        stats.failures++;
+        return false;
+    }
+    stats.clears++;
+    state.high = false;
+    state.low = false;
+    TRACE_INFO(reading.address, "alarm over at {}m°C", reading.value.MilliCelsius());
+    return true;
+}
+
+/**
+ * @brief program the thermostat of a sensor: trip points, TOUT polarity
+ *        and continuous conversion, then clear the flags latched under
+ *        the old limits. A sensor added before takes over the written
+ *        trip points without reading them back.
+ *
+ * @param sensor sensor to arm
+ * @param high TH - THF latches at or above it
+ * @param low TL - TLF latches at or below it
+ * @param polarityHigh TOUT is active high
+ * @return false if a write was not taken
+ */
+bool DS1631_AlarmMonitor::Arm(DS1631 &sensor, DS1631_Temperature high, DS1631_Temperature low, bool polarityHigh)
+{
+    // TH, TL and POL/1SHOT are EEPROM - the writes wait for each other, unchanged values are not written
+    bool ret = sensor.WriteUpperTempTripPoint(high);
+    ret = ret && sensor.WriteLowerTempTripPoint(low);
+    ret = ret && sensor.Config().Set<DS1631_Config::ToutPolarity>(polarityHigh ? 1 : 0).Set<DS1631_Config::OneShot>(0).Commit();
+    ret = ret && sensor.ClearAlarmFlags(DS1631_CONFIG_TEMP_HIGH_FLAG | DS1631_CONFIG_TEMP_LOW_FLAG);
+    ret = ret && sensor.StartConvert();
+    SensorState *state = Find(&sensor);
+    if (ret && state)
+    {
+        // the chip keeps 12 bits of the written limits
+        state->upper = high.Rounded(12);
+        state->lower = low.Rounded(12);
+        state->high = false;
+        state->low = false;
+    }
+    if (!ret)
+    {
+        TRACE_ERROR(sensor.getAddress(), "failed to arm the thermostat");
+    }
+    return ret;
+}
+
+/**
+ * @brief read the flags of all sensors - one transfer per adapter. The
+ *        temperature of a sensor is only read if a flag latched. An alarm
+ *        is reported once; its flags are cleared with one config write
+ *        when the temperature is back between the trip points, until then
+ *        only the temperature of the sensor is read.
+ *
+ * @param events sensors whose thermostat tripped since the last poll
+ * @return true if all sensors answered
+ */
+bool DS1631_AlarmMonitor::Poll(std::vector<DS1631_AlarmEvent> &events)
+{
+    events.clear();
+    stats.polls++;
+    bool ret = true;
+    for (BusGroup &group : groups)
+    {
+        group.polled.clear();
+        for (size_t i = 0; i < group.sensors.size(); i++)
+        {
+            if (!group.state[i].high && !group.state[i].low)
+                group.polled.push_back(group.sensors[i]);
+        }
+        if (!group.polled.empty())
+        {
+            ret = DS1631::ReadStatusAll(*group.bus, group.polled, group.status) && ret;
+            stats.statusReads += group.polled.size();
+        }
+
+        size_t polled = 0;
+        for (size_t i = 0; i < group.sensors.size(); i++)
+        {
+            DS1631 *sensor = group.sensors[i];
+            SensorState &state = group.state[i];
+            if (state.high || state.low)
+            {
+                // reported already - the flags stay latched until the alarm is over
+                DS1631_Reading reading = sensor->Read();
+                stats.temperatureReads++;
+                if (!reading.valid)
+                {
+                    stats.failures++;
+                    ret = false;
+                }
+                Settle(sensor, state, reading);
+                continue;
+            }
+
+            DS1631_Status const &status = group.status[polled++];
+            if (!status.valid)
+            {
+                stats.failures++;
+                continue;
+            }
+            if (!status.tempHighFlag && !status.tempLowFlag)
+            {
+                continue;
+            }
+
+            DS1631_AlarmEvent event;
+            event.adapter = group.bus->getAdapter();
+            event.high = status.tempHighFlag;
+            event.low = status.tempLowFlag;
+            event.reading = sensor->Read();
+            event.address = event.reading.address;
+            event.timestamp = std::chrono::system_clock::now();
+            event.sensor = sensor;
+            stats.temperatureReads++;
+
+            state.high = status.tempHighFlag;
+            state.low = status.tempLowFlag;
+            TRACE_INFO(event.address, "alarm high={} low={} at {}m°C", event.high, event.low, event.reading.value.MilliCelsius());
+            events.push_back(event);
+            // a short excursion is over already
+            Settle(sensor, state, event.reading);
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief print the traffic of the monitor next to what reading every
+ *        temperature in every poll would have cost. Bytes on the wire
+ *        include the address bytes: 4 for a flag read, 5 for a
+ *        temperature read, 3 for a flag clear.
+ *
+ * @param out stream to print to
+ */
+void DS1631_AlarmMonitor::Print(std::ostream &out)
+{
+    unsigned long bytes = stats.statusReads * 4 + stats.temperatureReads * 5 + stats.clears * 3;
+    unsigned long sensors = 0;
+    for (BusGroup const &group : groups)
+        sensors += group.sensors.size();
+    unsigned long polling = stats.polls * sensors * 5;
+    out << std::dec << "alarm polls=" << stats.polls << " flag reads=" << stats.statusReads
+        << " temperature reads=" << stats.temperatureReads << " clears=" << stats.clears
+        << " failures=" << stats.failures << " bytes=" << bytes << " (temperature polling " << polling << ")" << std::endl;
+}
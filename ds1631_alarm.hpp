@@ -0,0 +1,97 @@
+/**
+ * @file ds1631_alarm.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief alarm monitoring of DS1631 sensors by their hardware thermostat -
+ *        only the latched THF/TLF flags are polled, the temperature is
+ *        read when a flag tripped
+ * @version 0.1
+ * @date 2019-06-18
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "ds1631.hpp"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief a sensor whose thermostat latched a flag since the last poll
+ *
+ */
+struct DS1631_AlarmEvent
+{
+    std::string adapter;
+    int address;
+    bool high;       // THF: temperature reached TH
+    bool low;        // TLF: temperature reached TL
+    DS1631_Reading reading; // temperature read after the flag was seen
+    std::chrono::system_clock::time_point timestamp;
+    DS1631 *sensor;
+};
+
+/**
+ * @brief bus traffic of the monitor
+ *
+ */
+struct DS1631_AlarmStats
+{
+    unsigned long polls;
+    unsigned long statusReads;      // 1 byte config reads
+    unsigned long temperatureReads; // 2 byte reads after a flag tripped
+    unsigned long clears;           // config writes clearing the flags
+    unsigned long failures;
+};
+
+class DS1631_AlarmMonitor
+{
+public:
+    DS1631_AlarmMonitor();
+    ~DS1631_AlarmMonitor();
+
+    void AddSensor(I2C_Bus &bus, DS1631 *sensor);
+    bool Arm(DS1631 &sensor, DS1631_Temperature high, DS1631_Temperature low, bool polarityHigh);
+    bool Poll(std::vector<DS1631_AlarmEvent> &events);
+
+    DS1631_AlarmStats getStats(){return stats;}
+    void Print(std::ostream &out);
+
+private:
+    /**
+     * @brief alarm state of one sensor - the chip latches a flag again
+     *        after every conversion beyond its trip point, so an alarm is
+     *        followed by the temperature until it is back inside
+     *
+     */
+    struct SensorState
+    {
+        DS1631_Temperature upper; // TH
+        DS1631_Temperature lower; // TL
+        bool high;                // reported, flags not cleared yet
+        bool low;
+    };
+
+    /**
+     * @brief sensors of one adapter - their flags are read in one transfer
+     *
+     */
+    struct BusGroup
+    {
+        I2C_Bus *bus;
+        std::vector<DS1631 *> sensors;
+        std::vector<DS1631 *> polled; // sensors without a reported alarm - their flags are read
+        std::vector<DS1631_Status> status;
+        std::vector<SensorState> state;
+    };
+
+    SensorState *Find(DS1631 *sensor);
+    bool Settle(DS1631 *sensor, SensorState &state, DS1631_Reading const &reading);
+
+    std::vector<BusGroup> groups;
+    DS1631_AlarmStats stats;
+};
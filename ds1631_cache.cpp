@@ -0,0 +1,80 @@
+/**
+ * @file ds1631_cache.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief read-through cache of the last temperature of a DS1631 - any
+ *        number of readers share one bus read per conversion
+ * @version 0.1
+ * @date 2019-06-19
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include "ds1631_cache.hpp"
+
+#define TRACE_COMPONENT "DS1631_Cache"
+#include "tracer.hpp"
+
+/**
+ * @brief Construct an empty cache
+ *
+ * @param ds1631 sensor - has to live as long as the cache
+ */
+DS1631_SampleCache::DS1631_SampleCache(DS1631 &ds1631) : sensor(ds1631), valid(false), hits(0), misses(0)
+{
+}
+
+/**
+ * @brief Destroy the cache
+ *
+ */
+DS1631_SampleCache::~DS1631_SampleCache()
+{
+}
+
+/**
+ * @brief temperature not older than maxAge. The cached reading is also
+ *        returned when it is older, but the sensor has not finished a
+ *        conversion since - a bus read would deliver the same value.
+ *        Otherwise the sensor is read; readers arriving meanwhile wait for
+ *        this read instead of starting their own.
+ *
+ * @param maxAge accepted age of the temperature (measured from the end of
+ *        its conversion)
+ * @return DS1631_CachedReading reading with the time of its conversion
+ */
+DS1631_CachedReading DS1631_SampleCache::Read(std::chrono::microseconds maxAge)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (valid && (((now - last.timestamp) <= maxAge) || (sensor.ConversionFinished(now) <= last.timestamp)))
+    {
+        hits++;
+        DS1631_CachedReading result = last;
+        result.cached = true;
+        return result;
+    }
+
+    misses++;
+    DS1631_CachedReading result;
+    result.reading = sensor.Read();
+    result.timestamp = sensor.ConversionFinished(std::chrono::steady_clock::now());
+    result.cached = false;
+    if (result.reading.valid)
+    {
+        last = result;
+        valid = true;
+    }
+    TRACE_DEBUG(result.reading.address, "read from the sensor, {} hits {} misses", hits, misses);
+    return result;
+}
+
+/**
+ * @brief forget the cached reading, e.g. after the resolution changed
+ *
+ */
+void DS1631_SampleCache::Invalidate()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    valid = false;
+}
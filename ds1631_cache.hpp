@@ -0,0 +1,54 @@
+/**
+ * @file ds1631_cache.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief read-through cache of the last temperature of a DS1631 - any
+ *        number of readers share one bus read per conversion
+ * @version 0.1
+ * @date 2019-06-19
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "ds1631.hpp"
+
+#include <chrono>
+#include <mutex>
+
+/**
+ * @brief reading delivered by the cache
+ *
+ */
+struct DS1631_CachedReading
+{
+    DS1631_Reading reading;
+    std::chrono::steady_clock::time_point timestamp; // end of the conversion the temperature comes from
+    bool cached;                                     // no bus access for this reading
+};
+
+class DS1631_SampleCache
+{
+public:
+    DS1631_SampleCache(DS1631 &ds1631);
+    ~DS1631_SampleCache();
+
+    DS1631_SampleCache(DS1631_SampleCache const &) = delete;
+    DS1631_SampleCache &operator=(DS1631_SampleCache const &) = delete;
+
+    DS1631_CachedReading Read(std::chrono::microseconds maxAge);
+    void Invalidate();
+
+    unsigned long getHits(){return hits;}
+    unsigned long getMisses(){return misses;}
+
+private:
+    DS1631 &sensor;
+
+    std::mutex lock; // held during the bus read - concurrent readers wait for its result
+    bool valid;
+    DS1631_CachedReading last;
+    unsigned long hits;
+    unsigned long misses;
+};
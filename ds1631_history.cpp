@@ -0,0 +1,266 @@
+/**
+ * @file ds1631_history.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief in-memory history of one DS1631: ring buffer of the raw samples
+ *        and per second / minute / hour rollups, written by one producer
+ *        and read lock-free by any number of consumers
+ * @version 0.1
+ * @date 2019-06-19
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <algorithm>
+
+#include "ds1631_history.hpp"
+
+const int DS1631_History::Buckets[DS1631_NUM_ROLLUPS] = {60, 60, 24};
+const long long DS1631_History::BucketLength[DS1631_NUM_ROLLUPS] = {1000000LL, 60000000LL, 3600000000LL};
+
+static long long Micros(std::chrono::system_clock::time_point timestamp)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(timestamp.time_since_epoch()).count();
+}
+
+// number of the span of the given length a time falls into (rounded down for times before the epoch)
+static long long SpanId(long long micros, long long length)
+{
+    return (micros >= 0) ? (micros / length) : -((length - 1 - micros) / length);
+}
+
+/**
+ * @brief Construct an empty history - all memory is allocated here, Add
+ *        and the queries do not allocate
+ *
+ * @param capacity raw samples kept
+ */
+DS1631_History::DS1631_History(size_t capacity)
+    : capacity(std::max(capacity, static_cast<size_t>(1))), slots(new Slot[this->capacity]), written(0), newest(0)
+{
+    for (size_t i = 0; i < this->capacity; i++)
+    {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+        slots[i].time.store(0, std::memory_order_relaxed);
+        slots[i].raw.store(0, std::memory_order_relaxed);
+    }
+    for (int level = 0; level < DS1631_NUM_ROLLUPS; level++)
+    {
+        rollups[level].reset(new Bucket[Buckets[level]]);
+        for (int i = 0; i < Buckets[level]; i++)
+        {
+            Bucket &bucket = rollups[level][i];
+            bucket.sequence.store(0, std::memory_order_relaxed);
+            bucket.id.store(0, std::memory_order_relaxed);
+            bucket.count.store(0, std::memory_order_relaxed);
+            bucket.sum.store(0, std::memory_order_relaxed);
+            bucket.min.store(0, std::memory_order_relaxed);
+            bucket.max.store(0, std::memory_order_relaxed);
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * @brief Destroy the history
+ *
+ */
+DS1631_History::~DS1631_History()
+{
+}
+
+/**
+ * @brief fold a sample into a rollup bucket; a bucket still holding an
+ *        older span starts over (producer only)
+ *
+ */
+void DS1631_History::Update(Bucket &bucket, long long id, int raw)
+{
+    unsigned long long sequence = bucket.sequence.load(std::memory_order_relaxed);
+    bucket.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if ((sequence == 0) || (bucket.id.load(std::memory_order_relaxed) != id))
+    {
+        bucket.id.store(id, std::memory_order_relaxed);
+        bucket.count.store(1, std::memory_order_relaxed);
+        bucket.sum.store(raw, std::memory_order_relaxed);
+        bucket.min.store(raw, std::memory_order_relaxed);
+        bucket.max.store(raw, std::memory_order_relaxed);
+    }
+    else
+    {
+        bucket.count.store(bucket.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        bucket.sum.store(bucket.sum.load(std::memory_order_relaxed) + raw, std::memory_order_relaxed);
+        bucket.min.store(std::min(bucket.min.load(std::memory_order_relaxed), raw), std::memory_order_relaxed);
+        bucket.max.store(std::max(bucket.max.load(std::memory_order_relaxed), raw), std::memory_order_relaxed);
+    }
+
+    bucket.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * @brief store a sample and update the rollups - O(1), no allocation.
+ *        Must only be called by one thread. A sample not newer than the
+ *        last one is dropped - reading a sensor again before its next
+ *        conversion delivers the same sample.
+ *
+ * @param timestamp time of the sample (end of its conversion)
+ * @param value temperature
+ * @return false if the sample was dropped
+ */
+bool DS1631_History::Add(std::chrono::system_clock::time_point timestamp, DS1631_Temperature value)
+{
+    long long micros = Micros(timestamp);
+    unsigned long long position = written.load(std::memory_order_relaxed);
+    if ((position > 0) && (micros <= newest))
+        return false;
+    newest = micros;
+    Slot &slot = slots[position % capacity];
+
+    slot.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(micros, std::memory_order_relaxed);
+    slot.raw.store(value.Raw(), std::memory_order_relaxed);
+    slot.sequence.store(2 * position + 2, std::memory_order_release);
+    written.store(position + 1, std::memory_order_release);
+
+    for (int level = 0; level < DS1631_NUM_ROLLUPS; level++)
+    {
+        long long id = SpanId(micros, BucketLength[level]);
+        long long index = id % Buckets[level];
+        if (index < 0)
+            index += Buckets[level];
+        Update(rollups[level][index], id, value.Raw());
+    }
+    return true;
+}
+
+/**
+ * @brief copy the newest samples, newest first. Samples overwritten by
+ *        the producer while they are copied are left out.
+ *
+ * @param samples destination
+ * @param count size of the destination
+ * @return number of samples copied
+ */
+size_t DS1631_History::Latest(DS1631_HistorySample *samples, size_t count)
+{
+    unsigned long long end = written.load(std::memory_order_acquire);
+    unsigned long long available = std::min(static_cast<unsigned long long>(capacity), end);
+    size_t copied = 0;
+    for (unsigned long long i = 0; (i < available) && (copied < count); i++)
+    {
+        unsigned long long position = end - 1 - i;
+        Slot &slot = slots[position % capacity];
+        unsigned long long before = slot.sequence.load(std::memory_order_acquire);
+        if (before != 2 * position + 2)
+            continue;
+        long long micros = slot.time.load(std::memory_order_relaxed);
+        int raw = slot.raw.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        samples[copied].timestamp = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(micros)));
+        samples[copied].value = DS1631_Temperature::FromRaw(static_cast<int16_t>(raw));
+        copied++;
+    }
+    return copied;
+}
+
+/**
+ * @brief consistent copy of a bucket if it holds the wanted span - retried
+ *        while the producer updates it
+ *
+ * @return false if the bucket holds another span or no sample
+ */
+bool DS1631_History::Snapshot(Bucket &bucket, long long id, DS1631_Rollup &rollup, long long &sum)
+{
+    for (;;)
+    {
+        unsigned long long before = bucket.sequence.load(std::memory_order_acquire);
+        if (before == 0)
+            return false;
+        if (before & 1)
+            continue;
+        long long spanId = bucket.id.load(std::memory_order_relaxed);
+        rollup.count = bucket.count.load(std::memory_order_relaxed);
+        sum = bucket.sum.load(std::memory_order_relaxed);
+        int min = bucket.min.load(std::memory_order_relaxed);
+        int max = bucket.max.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (bucket.sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        if (spanId != id)
+            return false;
+        rollup.min = DS1631_Temperature::FromRaw(static_cast<int16_t>(min));
+        rollup.max = DS1631_Temperature::FromRaw(static_cast<int16_t>(max));
+        return true;
+    }
+}
+
+/**
+ * @brief aggregate of the last spans of a level, the running one included
+ *        - e.g. Window(DS1631_ROLLUP_MINUTE, 60) is the last hour. Costs
+ *        at most Buckets[level] bucket reads, independent of the number
+ *        of samples.
+ *
+ * @param level span length
+ * @param buckets number of spans - limited to the buckets kept
+ * @param now end of the window
+ * @return DS1631_Rollup
+ */
+DS1631_Rollup DS1631_History::Window(DS1631_RollupLevel level, int buckets, std::chrono::system_clock::time_point now)
+{
+    DS1631_Rollup result = DS1631_Rollup();
+    long long total = 0;
+    long long current = SpanId(Micros(now), BucketLength[level]);
+    buckets = std::min(buckets, Buckets[level]);
+    for (int i = 0; i < buckets; i++)
+    {
+        long long id = current - i;
+        long long index = id % Buckets[level];
+        if (index < 0)
+            index += Buckets[level];
+        DS1631_Rollup span;
+        long long sum;
+        if (!Snapshot(rollups[level][index], id, span, sum))
+            continue;
+        if ((result.count == 0) || (span.min < result.min))
+            result.min = span.min;
+        if ((result.count == 0) || (span.max > result.max))
+            result.max = span.max;
+        result.count += span.count;
+        total += sum;
+    }
+    if (result.count > 0)
+    {
+        long long count = static_cast<long long>(result.count);
+        long long mean = (total + ((total < 0) ? -count / 2 : count / 2)) / count;
+        result.mean = DS1631_Temperature::FromRaw(static_cast<int16_t>(mean));
+    }
+    return result;
+}
+
+/**
+ * @brief print the rollups of the last minute, hour and day
+ *
+ * @param out stream to print to
+ */
+void DS1631_History::Print(std::ostream &out)
+{
+    static const char *const Names[DS1631_NUM_ROLLUPS] = {"minute", "hour", "day"};
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    out << std::dec << "samples=" << getWritten();
+    for (int level = 0; level < DS1631_NUM_ROLLUPS; level++)
+    {
+        DS1631_Rollup rollup = Window(static_cast<DS1631_RollupLevel>(level), Buckets[level], now);
+        out << " last " << Names[level] << ": count=" << rollup.count;
+        if (rollup.count > 0)
+        {
+            out << " min=" << rollup.min.Celsius() << " max=" << rollup.max.Celsius() << " mean=" << rollup.mean.Celsius();
+        }
+    }
+    out << std::endl;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file ds1631_history.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief in-memory history of one DS1631: ring buffer of the raw samples
+ *        and per second / minute / hour rollups, written by one producer
+ *        and read lock-free by any number of consumers
+ * @version 0.1
+ * @date 2019-06-19
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "ds1631_temperature.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+
+enum DS1631_RollupLevel
+{
+    DS1631_ROLLUP_SECOND = 0,
+    DS1631_ROLLUP_MINUTE,
+    DS1631_ROLLUP_HOUR,
+    DS1631_NUM_ROLLUPS
+};
+
+/**
+ * @brief one sample of the history
+ *
+ */
+struct DS1631_HistorySample
+{
+    std::chrono::system_clock::time_point timestamp;
+    DS1631_Temperature value;
+};
+
+/**
+ * @brief aggregate of the samples of a time span - count is 0 if the span
+ *        holds no sample (min, max and mean are 0 then)
+ *
+ */
+struct DS1631_Rollup
+{
+    unsigned long count;
+    DS1631_Temperature min;
+    DS1631_Temperature max;
+    DS1631_Temperature mean;
+};
+
+class DS1631_History
+{
+public:
+    // buckets kept per level: one minute of seconds, one hour of minutes, one day of hours
+    static const int Buckets[DS1631_NUM_ROLLUPS];
+    static const long long BucketLength[DS1631_NUM_ROLLUPS]; // µs
+
+    DS1631_History(size_t capacity);
+    ~DS1631_History();
+
+    DS1631_History(DS1631_History const &) = delete;
+    DS1631_History &operator=(DS1631_History const &) = delete;
+
+    // producer - one thread only
+    bool Add(std::chrono::system_clock::time_point timestamp, DS1631_Temperature value);
+
+    // consumers - any thread
+    size_t Latest(DS1631_HistorySample *samples, size_t count);
+    DS1631_Rollup Window(DS1631_RollupLevel level, int buckets,
+                         std::chrono::system_clock::time_point now = std::chrono::system_clock::now());
+    unsigned long long getWritten(){return written.load(std::memory_order_acquire);}
+    size_t getCapacity(){return capacity;}
+
+    void Print(std::ostream &out);
+
+private:
+    /**
+     * @brief raw sample - sequence is odd while the producer writes it,
+     *        2 * (position + 1) once it holds the sample of that position
+     *
+     */
+    struct Slot
+    {
+        std::atomic<unsigned long long> sequence;
+        std::atomic<long long> time; // µs since the epoch
+        std::atomic<int> raw;
+    };
+
+    /**
+     * @brief rollup of one time span - same sequence scheme as Slot, id is
+     *        the number of the span since the epoch
+     *
+     */
+    struct Bucket
+    {
+        std::atomic<unsigned long long> sequence;
+        std::atomic<long long> id;
+        std::atomic<unsigned long> count;
+        std::atomic<long long> sum;
+        std::atomic<int> min;
+        std::atomic<int> max;
+    };
+
+    void Update(Bucket &bucket, long long id, int raw);
+    bool Snapshot(Bucket &bucket, long long id, DS1631_Rollup &rollup, long long &sum);
+
+    size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<unsigned long long> written;
+    long long newest; // µs of the last sample added - producer only
+    std::unique_ptr<Bucket[]> rollups[DS1631_NUM_ROLLUPS];
+};
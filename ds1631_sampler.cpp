@@ -0,0 +1,255 @@
+/**
+ * @file ds1631_sampler.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief sampling of DS1631 sensors spread over several i2c adapters
+ * @version 0.1
+ * @date 2019-06-14
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
+#include "ds1631_sampler.hpp"
+
+#define TRACE_COMPONENT "DS1631_Sampler"
+#include "tracer.hpp"
+
+// all sensors are started within a few transfers
+const std::chrono::microseconds DS1631_Sampler::DefaultMaxSkew(10000);
+
+/**
+ * @brief Construct a new sampler without any adapter
+ *
+ */
+DS1631_Sampler::DS1631_Sampler() : maxSkew(DefaultMaxSkew)
+{
+}
+
+/**
+ * @brief Destroy the sampler - stops the workers it created
+ *
+ */
+DS1631_Sampler::~DS1631_Sampler()
+{
+}
+
+/**
+ * @brief add an adapter whose traffic is already queued in a scheduler
+ *        (e.g. shared with a display) - the sweep of this adapter runs as
+ *        sensor traffic of that scheduler
+ *
+ * @param bus adapter
+ * @param scheduler worker of the adapter - nullptr to start a worker of its own
+ */
+void DS1631_Sampler::AddBus(I2C_Bus &bus, I2C_Scheduler *scheduler)
+{
+    BusGroup &group = Group(bus);
+    if (scheduler)
+    {
+        group.scheduler = scheduler;
+        group.ownScheduler.reset();
+    }
+}
+
+/**
+ * @brief add a sensor; an adapter that is not known yet gets a worker
+ *
+ * @param bus adapter the sensor is connected to
+ * @param sensor sensor - has to live as long as the sampler
+ */
+void DS1631_Sampler::AddSensor(I2C_Bus &bus, DS1631 *sensor)
+{
+    Group(bus).sensors.push_back(sensor);
+}
+
+DS1631_Sampler::BusGroup &DS1631_Sampler::Group(I2C_Bus &bus)
+{
+    for (std::unique_ptr<BusGroup> &group : groups)
+    {
+        if (group->bus == &bus)
+            return *group;
+    }
+    groups.emplace_back(new BusGroup());
+    BusGroup &group = *groups.back();
+    group.bus = &bus;
+    group.ownScheduler.reset(new I2C_Scheduler());
+    group.scheduler = group.ownScheduler.get();
+    group.duration = std::chrono::microseconds(0);
+    group.resync = false;
+    return group;
+}
+
+/**
+ * @brief start the conversion of all sensors of one adapter - runs on its
+ *        worker
+ *
+ * @param group adapter and its sensors
+ * @return true if all sensors acknowledged the start
+ */
+bool DS1631_Sampler::StartBus(BusGroup &group)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (group.resync)
+    {
+        // a continuous conversion keeps its phase - stop it to start it with the others
+        for (DS1631 *sensor : group.sensors)
+        {
+            if (sensor->isConverting())
+                sensor->StopConvert();
+        }
+        group.resync = false;
+    }
+    // one I2C_RDWR for all conversions
+    bool ret = DS1631::StartConvertAll(*group.bus, group.sensors);
+    group.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return ret;
+}
+
+/**
+ * @brief check DONE of the one-shot sensors of one adapter once - runs on
+ *        its worker and never waits there
+ *
+ * @param group adapter and its sensors; retry tells when to check again
+ * @return false if a sensor did not answer or did not finish in time
+ */
+bool DS1631_Sampler::CheckBus(BusGroup &group)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ret = DS1631::CheckConversionAll(group.sensors, group.retry);
+    group.duration += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return ret;
+}
+
+/**
+ * @brief read all sensors of one adapter once their conversions are
+ *        done - runs on its worker
+ *
+ * @param group adapter and its sensors
+ * @return true if all sensors delivered a temperature
+ */
+bool DS1631_Sampler::ReadBus(BusGroup &group)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // one I2C_RDWR for all temperatures
+    bool ret = DS1631::ReadTemperatureAll(*group.bus, group.sensors, group.readings);
+    std::chrono::steady_clock::time_point read = std::chrono::steady_clock::now();
+    group.finished.resize(group.sensors.size());
+    for (size_t i = 0; i < group.sensors.size(); i++)
+    {
+        group.finished[i] = group.sensors[i]->ConversionFinished(read);
+    }
+    group.duration += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    TRACE_DEBUG(TRACE_NO_ADDRESS, "{} sensors in {}us", group.sensors.size(), group.duration.count());
+    return ret;
+}
+
+/**
+ * @brief sample all sensors - the adapters are swept in parallel, so the
+ *        sweep takes as long as the busiest adapter plus the conversion
+ *        time of the slowest sensor. The wait is spent on the calling
+ *        thread, the workers stay free for other traffic meanwhile: each
+ *        DONE check of the one-shot sensors is a short job of its own,
+ *        the time between the checks is slept here as well.
+ *        Every sample is stamped with the end of its conversion; if the
+ *        stamps spread wider than the skew bound, the next sweep restarts
+ *        the running conversions together.
+ *
+ * @param result samples of all sensors
+ * @return true if all sensors delivered a temperature
+ */
+bool DS1631_Sampler::Sweep(DS1631_SampleSet &result)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result.started = std::chrono::system_clock::now();
+    result.samples.clear();
+    result.busiest = std::chrono::microseconds(0);
+
+    bool ret = true;
+    std::vector<std::future<bool> > done;
+    for (std::unique_ptr<BusGroup> &group : groups)
+    {
+        BusGroup *bus_group = group.get();
+        done.push_back(group->scheduler->Post(I2C_CLASS_SENSOR, [bus_group] { return StartBus(*bus_group); }));
+    }
+    std::chrono::steady_clock::time_point due;
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        ret = done[i].get() && ret;
+        due = std::max(due, DS1631::ConversionDue(groups[i]->sensors));
+    }
+    std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_until(due);
+
+    // one-shot sensors confirm DONE - normally a single check per adapter
+    std::vector<BusGroup *> checking;
+    for (std::unique_ptr<BusGroup> &group : groups)
+        checking.push_back(group.get());
+    while (!checking.empty())
+    {
+        done.clear();
+        for (BusGroup *bus_group : checking)
+            done.push_back(bus_group->scheduler->Post(I2C_CLASS_SENSOR, [bus_group] { return CheckBus(*bus_group); }));
+        std::vector<BusGroup *> pending;
+        std::chrono::steady_clock::time_point retry;
+        for (size_t i = 0; i < checking.size(); i++)
+        {
+            ret = done[i].get() && ret;
+            if (checking[i]->retry == std::chrono::steady_clock::time_point())
+                continue;
+            if (pending.empty() || (checking[i]->retry < retry))
+                retry = checking[i]->retry;
+            pending.push_back(checking[i]);
+        }
+        checking.swap(pending);
+        std::this_thread::sleep_until(retry);
+    }
+    result.waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - waitStart);
+
+    done.clear();
+    for (std::unique_ptr<BusGroup> &group : groups)
+    {
+        BusGroup *bus_group = group.get();
+        done.push_back(group->scheduler->Post(I2C_CLASS_SENSOR, [bus_group] { return ReadBus(*bus_group); }));
+    }
+    // steady clock of the workers to wall clock of the samples
+    std::chrono::system_clock::time_point wallNow = std::chrono::system_clock::now();
+    std::chrono::steady_clock::time_point steadyNow = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point oldest = std::chrono::steady_clock::time_point::max();
+    std::chrono::steady_clock::time_point newest = std::chrono::steady_clock::time_point::min();
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        ret = done[i].get() && ret;
+        BusGroup &group = *groups[i];
+        for (size_t j = 0; j < group.readings.size(); j++)
+        {
+            DS1631_Reading const &reading = group.readings[j];
+            std::chrono::steady_clock::time_point finished = group.finished[j];
+            std::chrono::system_clock::time_point timestamp =
+                wallNow - std::chrono::duration_cast<std::chrono::system_clock::duration>(steadyNow - finished);
+            result.samples.push_back(DS1631_Sample{group.bus->getAdapter(), reading.address, reading.valid,
+                                                   reading.value, timestamp, group.sensors[j]});
+            if (reading.valid)
+            {
+                oldest = std::min(oldest, finished);
+                newest = std::max(newest, finished);
+            }
+        }
+        if (group.duration > result.busiest)
+            result.busiest = group.duration;
+    }
+    result.skew = (newest > oldest) ? std::chrono::duration_cast<std::chrono::microseconds>(newest - oldest)
+                                    : std::chrono::microseconds(0);
+    result.aligned = (result.skew <= maxSkew);
+    if (!result.aligned)
+    {
+        TRACE_INFO(TRACE_NO_ADDRESS, "skew {}us above {}us - conversions are restarted", result.skew.count(), maxSkew.count());
+        for (std::unique_ptr<BusGroup> &group : groups)
+            group->resync = true;
+    }
+    result.duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return ret;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file ds1631_sampler.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief sampling of DS1631 sensors spread over several i2c adapters
+ * @version 0.1
+ * @date 2019-06-14
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "ds1631.hpp"
+#include "I2C_Scheduler.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief reading of one sensor in a sweep
+ *
+ */
+struct DS1631_Sample
+{
+    std::string adapter;
+    int address;
+    bool valid;
+    DS1631_Temperature value;
+    std::chrono::system_clock::time_point timestamp; // end of the conversion the temperature comes from
+    DS1631 *sensor;
+
+    float Celsius() const {return valid ? value.Celsius() : NAN;}
+};
+
+/**
+ * @brief merged result of all adapters - samples are ordered by adapter
+ *        (in the order they were added) and by sensor
+ *
+ */
+struct DS1631_SampleSet
+{
+    std::chrono::system_clock::time_point started;
+    std::chrono::microseconds duration;  // whole sweep
+    std::chrono::microseconds busiest;   // slowest single adapter
+    std::chrono::microseconds waited;    // for the conversions to finish
+    std::chrono::microseconds skew;      // between the oldest and the newest valid sample
+    bool aligned;                        // skew within the bound of the sampler
+    std::vector<DS1631_Sample> samples;
+};
+
+class DS1631_Sampler
+{
+public:
+    DS1631_Sampler();
+    ~DS1631_Sampler();
+
+    DS1631_Sampler(DS1631_Sampler const &) = delete;
+    DS1631_Sampler &operator=(DS1631_Sampler const &) = delete;
+
+    void AddBus(I2C_Bus &bus, I2C_Scheduler *scheduler);
+    void AddSensor(I2C_Bus &bus, DS1631 *sensor);
+
+    bool Sweep(DS1631_SampleSet &result);
+
+    void SetMaxSkew(std::chrono::microseconds bound){maxSkew = bound;}
+    std::chrono::microseconds getMaxSkew(){return maxSkew;}
+    static const std::chrono::microseconds DefaultMaxSkew;
+
+    size_t getBusCount(){return groups.size();}
+
+private:
+    /**
+     * @brief sensors of one adapter and the worker executing their sweep
+     *
+     */
+    struct BusGroup
+    {
+        I2C_Bus *bus;
+        I2C_Scheduler *scheduler;
+        std::unique_ptr<I2C_Scheduler> ownScheduler;
+        std::vector<DS1631 *> sensors;
+        std::vector<DS1631_Reading> readings;
+        std::vector<std::chrono::steady_clock::time_point> finished; // per sensor
+        bool resync; // restart running conversions so they finish together
+        std::chrono::steady_clock::time_point retry; // next DONE check - epoch if none is pending
+        std::chrono::microseconds duration;
+    };
+
+    BusGroup &Group(I2C_Bus &bus);
+    static bool StartBus(BusGroup &group);
+    static bool CheckBus(BusGroup &group);
+    static bool ReadBus(BusGroup &group);
+
+    std::chrono::microseconds maxSkew;
+    std::vector<std::unique_ptr<BusGroup> > groups;
+};
@@ -0,0 +1,272 @@
+/**
+ * @file ds1631_sim.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief register level model of the DS1631 for the simulated i2c bus
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <cmath>
+
+#include "ds1631.hpp"
+#include "ds1631_sim.hpp"
+
+// temperature register after power up: -60°C
+#define DS1631_POWER_UP_TEMPERATURE ((short)0xC400)
+
+/**
+ * @brief Construct a new DS1631 model with factory settings
+ *        (12 bit, continuous mode, TH=15°C, TL=10°C)
+ * 
+ * @param temperature constant ambient temperature in °C
+ */
+DS1631_Sim::DS1631_Sim(float temperature)
+    : created(Clock::now()),
+      pointer(DS1631_READ_TEMPERATURE),
+      th(0x0F00),
+      tl(0x0A00),
+      config(DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0),
+      nvmWriteTime(std::chrono::milliseconds(10)),
+      conversions(0),
+      nvmWrites(0)
+{
+    SetTemperature(temperature);
+    PowerOnReset();
+}
+
+DS1631_Sim::~DS1631_Sim()
+{
+}
+
+/**
+ * @brief conversion time of a resolution (DS1631_CONFIG_09BIT_094MS ..)
+ * 
+ * @param resolution value of the R1:R0 bits
+ * @return maximum conversion time from the datasheet
+ */
+std::chrono::microseconds DS1631_Sim::ConversionTime(int resolution)
+{
+    return std::chrono::microseconds(93750 << (resolution & 3));
+}
+
+/**
+ * @brief use a constant ambient temperature
+ */
+void DS1631_Sim::SetTemperature(float temperature)
+{
+    SetTemperatureSource([temperature](double) { return temperature; });
+}
+
+/**
+ * @brief use a temperature curve
+ * 
+ * @param temperatureSource ambient temperature in °C over seconds since construction
+ */
+void DS1631_Sim::SetTemperatureSource(std::function<float(double seconds)> temperatureSource)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    source = temperatureSource;
+}
+
+/**
+ * @brief set how long the NVB flag stays set after an EEPROM write
+ */
+void DS1631_Sim::SetNvmWriteTime(std::chrono::microseconds writeTime)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    nvmWriteTime = writeTime;
+}
+
+/**
+ * @brief reset of the volatile state (power up or software POR).
+ *        EEPROM content (TH, TL, NV config bits) is kept.
+ */
+void DS1631_Sim::PowerOnReset()
+{
+    temperatureRegister = DS1631_POWER_UP_TEMPERATURE;
+    // R1/R0 are volatile - the chip powers up at 12 bit
+    config = (config & DS1631_CONFIG_NVM_BITS) | DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0 |
+             DS1631_CONFIG_CONVERSTION_DONE_FLAG;
+    converting = false;
+    nvmDue = Clock::now();
+}
+
+/**
+ * @brief latch a finished conversion (lock must be held)
+ * 
+ * @param at time the conversion finished
+ */
+void DS1631_Sim::CompleteConversion(Clock::time_point at)
+{
+    double seconds = std::chrono::duration<double>(at - created).count();
+    int resolution = (config & (DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0)) >> 2;
+    // 12 bit = 1/16°C, every bit less doubles the step; the register is left aligned
+    int steps = (int)std::floor(source(seconds) * (2 << resolution));
+    temperatureRegister = (short)(steps * (1 << (7 - resolution)));
+
+    config |= DS1631_CONFIG_CONVERSTION_DONE_FLAG;
+    if (temperatureRegister >= th)
+        config |= DS1631_CONFIG_TEMP_HIGH_FLAG;
+    if (temperatureRegister <= tl)
+        config |= DS1631_CONFIG_TEMP_LOW_FLAG;
+    conversions++;
+}
+
+/**
+ * @brief advance conversions and EEPROM cycle to now (lock must be held)
+ */
+void DS1631_Sim::Update(Clock::time_point now)
+{
+    if (now >= nvmDue)
+    {
+        config &= ~DS1631_CONFIG_NVM_BUSY_FLAG;
+    }
+
+    while (converting && (now >= conversionDue))
+    {
+        CompleteConversion(conversionDue);
+        if (config & DS1631_CONFIG_1SHOT_CONVERSION)
+        {
+            converting = false;
+        }
+        else
+        {
+            int resolution = (config & (DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0)) >> 2;
+            conversionDue += ConversionTime(resolution);
+        }
+    }
+}
+
+/**
+ * @brief start an EEPROM cycle (lock must be held)
+ */
+void DS1631_Sim::StartNvmWrite(Clock::time_point now)
+{
+    config |= DS1631_CONFIG_NVM_BUSY_FLAG;
+    nvmDue = now + nvmWriteTime;
+    nvmWrites++;
+}
+
+/**
+ * @brief command byte (sets the pointer) optionally followed by data
+ * 
+ * @return false (NACK) for unknown commands and EEPROM writes while NVB is set
+ */
+bool DS1631_Sim::Write(unsigned char const *buffer, const int length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Clock::time_point now = Clock::now();
+    Update(now);
+
+    if (length == 0)
+    {
+        return true; // quick write - address ACK only
+    }
+
+    pointer = buffer[0];
+    switch (pointer)
+    {
+        case DS1631_START_CONVERT_T:
+        {
+            if (!converting)
+            {
+                int resolution = (config & (DS1631_CONFIG_RESOLUTION_BIT1 | DS1631_CONFIG_RESOLUTION_BIT0)) >> 2;
+                converting = true;
+                conversionDue = now + ConversionTime(resolution);
+                if (config & DS1631_CONFIG_1SHOT_CONVERSION)
+                    config &= ~DS1631_CONFIG_CONVERSTION_DONE_FLAG;
+            }
+            return true;
+        }
+        case DS1631_STOP_CONVERT_T:
+        {
+            converting = false;
+            return true;
+        }
+        case DS1631_SOFTWARE_POR:
+        {
+            PowerOnReset();
+            return true;
+        }
+        case DS1631_READ_TEMPERATURE:
+        {
+            return length == 1; // read only
+        }
+        case DS1631_ACCESS_TH:
+        case DS1631_ACCESS_TL:
+        {
+            if (length == 1)
+                return true; // pointer only
+            if (config & DS1631_CONFIG_NVM_BUSY_FLAG)
+                return false;
+            short value = (short)((buffer[1] << 8) | ((length > 2) ? buffer[2] : 0));
+            if (pointer == DS1631_ACCESS_TH)
+                th = value;
+            else
+                tl = value;
+            StartNvmWrite(now);
+            return true;
+        }
+        case DS1631_ACCESS_CONFIG:
+        {
+            if (length == 1)
+                return true; // pointer only
+            if (config & DS1631_CONFIG_NVM_BUSY_FLAG)
+                return false;
+            unsigned char value = buffer[1];
+            // THF/TLF can only be cleared, DONE and NVB are read only
+            unsigned char flags = config & (DS1631_CONFIG_TEMP_HIGH_FLAG | DS1631_CONFIG_TEMP_LOW_FLAG);
+            flags &= value;
+            // only a change of the EEPROM bits starts a write cycle
+            bool nvm = ((config ^ value) & DS1631_CONFIG_NVM_BITS) != 0;
+            config = (config & (DS1631_CONFIG_CONVERSTION_DONE_FLAG | DS1631_CONFIG_NVM_BUSY_FLAG)) |
+                     flags | (value & DS1631_CONFIG_SETUP_BITS);
+            if (nvm)
+                StartNvmWrite(now);
+            return true;
+        }
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief read the register selected by the last command
+ * 
+ * @return false (NACK) if the pointer does not address a readable register
+ */
+bool DS1631_Sim::Read(unsigned char *buffer, const int length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    Update(Clock::now());
+
+    unsigned short value;
+    switch (pointer)
+    {
+        case DS1631_READ_TEMPERATURE:
+            value = temperatureRegister;
+            break;
+        case DS1631_ACCESS_TH:
+            value = th;
+            break;
+        case DS1631_ACCESS_TL:
+            value = tl;
+            break;
+        case DS1631_ACCESS_CONFIG:
+            value = config << 8;
+            break;
+        default:
+            return false;
+    }
+
+    for (int i = 0; i < length; i++)
+    {
+        buffer[i] = (i % 2) ? (value & 0xFF) : (value >> 8);
+    }
+    return true;
+}
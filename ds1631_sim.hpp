@@ -0,0 +1,64 @@
+/**
+ * @file ds1631_sim.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief register level model of the DS1631 for the simulated i2c bus
+ * @version 0.1
+ * @date 2019-06-10
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include "I2C_SimBus.hpp"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+class DS1631_Sim : public I2C_SimDevice
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    DS1631_Sim(float temperature);
+    ~DS1631_Sim();
+
+    virtual bool Write(unsigned char const *buffer, const int length);
+    virtual bool Read(unsigned char *buffer, const int length);
+
+    void SetTemperature(float temperature);
+    void SetTemperatureSource(std::function<float(double seconds)> source);
+    void SetNvmWriteTime(std::chrono::microseconds writeTime);
+
+    unsigned long getConversions(){return conversions;}
+    unsigned long getNvmWrites(){return nvmWrites;}
+
+    static std::chrono::microseconds ConversionTime(int resolution);
+
+private:
+    void Update(Clock::time_point now);
+    void CompleteConversion(Clock::time_point at);
+    void StartNvmWrite(Clock::time_point now);
+    void PowerOnReset();
+
+    std::mutex lock;
+    std::function<float(double seconds)> source;
+    Clock::time_point created;
+
+    // registers
+    unsigned char pointer;
+    short temperatureRegister;
+    short th;
+    short tl;
+    unsigned char config;
+
+    // conversion / eeprom state
+    bool converting;
+    Clock::time_point conversionDue;
+    Clock::time_point nvmDue;
+    std::chrono::microseconds nvmWriteTime;
+    unsigned long conversions;
+    unsigned long nvmWrites;
+};
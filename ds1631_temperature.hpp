@@ -0,0 +1,120 @@
+/**
+ * @file ds1631_temperature.hpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief temperature in the register format of the DS1631: 16 bit two's
+ *        complement with 8 fraction bits (Q8.8), 1/256°C per step
+ * @version 0.1
+ * @date 2019-06-18
+ *
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class DS1631_Temperature
+{
+public:
+    // 1°C
+    static constexpr int32_t One = 256;
+    // measuring range of the chip - conversions from °C are clamped to it
+    static constexpr int32_t MinRaw = -55 * One;
+    static constexpr int32_t MaxRaw = 125 * One;
+
+    constexpr DS1631_Temperature() : raw(0){}
+
+    /**
+     * @brief from the raw register value
+     *
+     */
+    static constexpr DS1631_Temperature FromRaw(int16_t value){return DS1631_Temperature(value);}
+
+    /**
+     * @brief from the two bytes read from the chip, MSB first
+     *
+     */
+    static constexpr DS1631_Temperature FromRegister(unsigned char msb, unsigned char lsb)
+    {
+        return DS1631_Temperature(static_cast<int16_t>((msb & 0x80) ? (((msb << 8) | lsb) - 0x10000) : ((msb << 8) | lsb)));
+    }
+
+    static constexpr DS1631_Temperature Min(){return DS1631_Temperature(static_cast<int16_t>(MinRaw));}
+    static constexpr DS1631_Temperature Max(){return DS1631_Temperature(static_cast<int16_t>(MaxRaw));}
+
+    /**
+     * @brief from °C, rounded to the nearest 1/256°C and clamped to the
+     *        range of the chip (NAN gives the minimum)
+     *
+     */
+    static constexpr DS1631_Temperature FromCelsius(double celsius)
+    {
+        return !(celsius > MinRaw / One) ? Min() : (celsius >= MaxRaw / One) ? Max()
+               : DS1631_Temperature(static_cast<int16_t>(celsius * One + ((celsius < 0) ? -0.5 : 0.5)));
+    }
+
+    /**
+     * @brief from m°C, rounded to the nearest 1/256°C and clamped to the
+     *        range of the chip - integer only
+     *
+     */
+    static constexpr DS1631_Temperature FromMilliCelsius(int32_t milli)
+    {
+        return (milli <= MinRaw / One * 1000) ? Min() : (milli >= MaxRaw / One * 1000) ? Max()
+               : DS1631_Temperature(static_cast<int16_t>((milli * One + ((milli < 0) ? -500 : 500)) / 1000));
+    }
+
+    constexpr int16_t Raw() const {return raw;}
+    constexpr unsigned char Msb() const {return static_cast<unsigned char>((raw >> 8) & 0xFF);}
+    constexpr unsigned char Lsb() const {return static_cast<unsigned char>(raw & 0xFF);}
+
+    constexpr float Celsius() const {return static_cast<float>(raw) / One;}
+    // rounded to the nearest m°C - integer only
+    constexpr int32_t MilliCelsius() const {return (raw * 1000 + ((raw < 0) ? -One / 2 : One / 2)) / One;}
+
+    /**
+     * @brief rounded to the nearest step of a resolution of the chip - the
+     *        register keeps 9 (1/2°C) to 12 (1/16°C) significant bits. The
+     *        result stays within the range of the chip.
+     *
+     * @param bits 9 ... 12
+     */
+    constexpr DS1631_Temperature Rounded(int bits) const
+    {
+        return Clamped((raw + (0x80 >> (bits - 8))) & ~((0x100 >> (bits - 8)) - 1));
+    }
+
+    constexpr bool operator==(DS1631_Temperature other) const {return raw == other.raw;}
+    constexpr bool operator!=(DS1631_Temperature other) const {return raw != other.raw;}
+    constexpr bool operator<(DS1631_Temperature other) const {return raw < other.raw;}
+    constexpr bool operator<=(DS1631_Temperature other) const {return raw <= other.raw;}
+    constexpr bool operator>(DS1631_Temperature other) const {return raw > other.raw;}
+    constexpr bool operator>=(DS1631_Temperature other) const {return raw >= other.raw;}
+
+    // difference in 1/256°C - does not overflow for any two temperatures
+    constexpr int32_t operator-(DS1631_Temperature other) const {return static_cast<int32_t>(raw) - other.raw;}
+
+private:
+    constexpr explicit DS1631_Temperature(int16_t value) : raw(value){}
+
+    static constexpr DS1631_Temperature Clamped(int32_t value)
+    {
+        return (value < MinRaw) ? Min() : (value > MaxRaw) ? Max() : DS1631_Temperature(static_cast<int16_t>(value));
+    }
+
+    int16_t raw;
+};
+
+static_assert(DS1631_Temperature::FromRegister(0xC4, 0x00).Raw() == -60 * DS1631_Temperature::One, "-60°C (power up value)");
+static_assert(DS1631_Temperature::FromRegister(0xFF, 0x80).MilliCelsius() == -500, "-0.5°C");
+static_assert(DS1631_Temperature::FromRegister(0x7D, 0x00).MilliCelsius() == 125000, "+125°C");
+static_assert(DS1631_Temperature::FromCelsius(-10.0625).Msb() == 0xF5, "encoding of a negative value");
+static_assert(DS1631_Temperature::FromCelsius(-10.0625).Lsb() == 0xF0, "encoding of a negative value");
+static_assert(DS1631_Temperature::FromMilliCelsius(30400).Rounded(12).Raw() == 486 * 16, "30.4°C at 12 bit is 30.375°C");
+static_assert(DS1631_Temperature::FromMilliCelsius(-250).Rounded(9).MilliCelsius() == 0, "-0.25°C at 9 bit rounds up to 0°C");
+static_assert(DS1631_Temperature::FromCelsius(200) == DS1631_Temperature::Max(), "above +125°C is clamped");
+static_assert(DS1631_Temperature::FromCelsius(-200) == DS1631_Temperature::Min(), "below -55°C is clamped");
+static_assert(DS1631_Temperature::FromMilliCelsius(125000) == DS1631_Temperature::Max(), "+125°C is the upper boundary");
+static_assert(DS1631_Temperature::FromMilliCelsius(-2000000000) == DS1631_Temperature::Min(), "no overflow of m°C");
+static_assert(DS1631_Temperature::FromRaw(0x7FFF).Rounded(9) == DS1631_Temperature::Max(), "rounding near +128°C does not wrap");
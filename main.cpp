@@ -9,25 +9,82 @@
  * 
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <new>
 #include <map>
+#include <vector>
 #include <boost/program_options.hpp>
 #include <exception>
+#include <stdexcept>
 #include <thread>
 #include <chrono>
 #include <ctime>
+#include <functional>
+#include <memory>
 
 #include "ds1631.hpp"
+#include "ds1631_sampler.hpp"
+#include "ds1631_adaptive.hpp"
+#include "ds1631_alarm.hpp"
+#include "ds1631_cache.hpp"
+#include "ds1631_history.hpp"
 #include "PcfLcd.hpp"
+#include "I2C_Scheduler.hpp"
+#include "I2C_SimBus.hpp"
+#include "I2C_Capture.hpp"
+#include "I2C_Inventory.hpp"
+#include "ds1631_sim.hpp"
+#include "PcfLcd_sim.hpp"
+#include "tracer.hpp"
 
 namespace po = boost::program_options;
 
+// every heap allocation of the program is counted - evaluated by --alloc-check
+static std::atomic<unsigned long> heap_allocations(0);
+
+void *operator new(std::size_t size)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
 int main(int ac, char **av)
 {
     boost::uint32_t ds1631_device_address  = -1;
     boost::uint32_t display_device_address = -1;
+    std::vector<std::string> i2c_adapters(1, "/dev/i2c-1");
     bool verbose = false;
+    bool schedule = false;
+    bool simulate = false;
+    bool stats = false;
+    bool alloc_check = false;
+    int adaptive_seconds = 0;
+    int alarm_seconds = 0;
+    int readers = 0;
+    int history_seconds = 0;
+    double alarm_high = NAN;
+    double alarm_low = NAN;
+    std::string record_file;
+    std::string replay_file;
+    double replay_speed = 1.0;
+    int timeout = -1;
+    int bus_retries = -1;
+    std::string inventory_file = "i2c_inventory.txt";
+    bool discover = false;
+    I2C_RetryPolicy retry_policy = I2C_Device::DefaultRetryPolicy;
 
     try
     {
@@ -36,6 +93,24 @@ int main(int ac, char **av)
         desc.add_options()("help,h", "produce help message")
                           ("t_device,t", po::value<std::string>(), "set used DS1631 device (hex value) - 0 for none")
                           ("d_device,d", po::value<int>(), "set used display device (dec value 0..16)")
+                          ("bus,b", po::value<std::vector<std::string> >()->composing(), "set used i2c adapter (default /dev/i2c-1) - repeat to sample several adapters in parallel")
+                          ("schedule,s", "queue bus transactions by priority (sensors before display) and report queueing delay")
+                          ("simulate", "use a simulated i2c bus with DS1631 models instead of the adapter")
+                          ("record", po::value<std::string>(), "record all bus traffic to a capture file")
+                          ("replay", po::value<std::string>(), "serve the bus traffic from a capture file instead of the adapter")
+                          ("replay-speed", po::value<double>(), "time scale of the replay (1 = recorded timing, 0 = no delay)")
+                          ("discover", "probe all adapters for DS1631 and PCF8574 devices and update the inventory")
+                          ("inventory", po::value<std::string>(), "inventory cache of the discovered devices (default i2c_inventory.txt)")
+                          ("timeout", po::value<int>(), "adapter timeout of a transfer in ms (I2C_TIMEOUT)")
+                          ("retries", po::value<int>(), "retries of a transient bus error per transaction (default 2) and of a lost arbitration in the adapter (I2C_RETRIES)")
+                          ("adaptive", po::value<int>(), "sample the sensors for the given seconds with a rate and resolution following the signal")
+                          ("alarm", po::value<int>(), "watch the thermostat flags of the sensors for the given seconds, read temperatures only on alarm")
+                          ("th", po::value<double>(), "upper trip point in °C programmed for --alarm (default: as stored in the sensor)")
+                          ("tl", po::value<double>(), "lower trip point in °C programmed for --alarm (default: as stored in the sensor)")
+                          ("readers", po::value<int>(), "let the given number of threads read all sensors through the sample cache")
+                          ("history", po::value<int>(), "sweep the sensors for the given seconds and print min/max/mean of the last minute, hour and day")
+                          ("alloc-check", "repeat sensor sweep and display refresh and fail if they allocate heap memory")
+                          ("stats", "print latency histograms, byte and error counters of every device")
                           ("verbose,v", "set trace to verbose");
 
         po::variables_map vm;
@@ -47,6 +122,96 @@ int main(int ac, char **av)
             verbose = true;
         }
 
+        if (vm.count("discover"))
+        {
+            discover = true;
+        }
+
+        if (vm.count("inventory"))
+        {
+            inventory_file = vm["inventory"].as<std::string>();
+        }
+
+        if (vm.count("timeout"))
+        {
+            timeout = vm["timeout"].as<int>();
+        }
+
+        if (vm.count("retries"))
+        {
+            retry_policy.retries = vm["retries"].as<int>();
+            bus_retries = retry_policy.retries;
+        }
+
+        if (vm.count("stats"))
+        {
+            stats = true;
+        }
+
+        if (vm.count("adaptive"))
+        {
+            adaptive_seconds = vm["adaptive"].as<int>();
+        }
+
+        if (vm.count("alarm"))
+        {
+            alarm_seconds = vm["alarm"].as<int>();
+        }
+
+        if (vm.count("th"))
+        {
+            alarm_high = vm["th"].as<double>();
+            if (!(alarm_high >= DS1631_Temperature::Min().Celsius()) || (alarm_high > DS1631_Temperature::Max().Celsius()))
+                throw std::out_of_range("--th outside the range of the sensor (-55...125°C)");
+        }
+
+        if (vm.count("tl"))
+        {
+            alarm_low = vm["tl"].as<double>();
+            if (!(alarm_low >= DS1631_Temperature::Min().Celsius()) || (alarm_low > DS1631_Temperature::Max().Celsius()))
+                throw std::out_of_range("--tl outside the range of the sensor (-55...125°C)");
+        }
+
+        if (vm.count("readers"))
+        {
+            readers = vm["readers"].as<int>();
+        }
+
+        if (vm.count("history"))
+        {
+            history_seconds = vm["history"].as<int>();
+        }
+
+        if (vm.count("alloc-check"))
+        {
+            alloc_check = true;
+        }
+
+        if (vm.count("schedule"))
+        {
+            schedule = true;
+        }
+
+        if (vm.count("simulate"))
+        {
+            simulate = true;
+        }
+
+        if (vm.count("record"))
+        {
+            record_file = vm["record"].as<std::string>();
+        }
+
+        if (vm.count("replay"))
+        {
+            replay_file = vm["replay"].as<std::string>();
+        }
+
+        if (vm.count("replay-speed"))
+        {
+            replay_speed = vm["replay-speed"].as<double>();
+        }
+
         if (vm.count("help"))
         {
             std::cout << desc << "\n";
@@ -69,6 +234,14 @@ int main(int ac, char **av)
                 std::cout << "using all DS1631 devices.\n";
         }
 
+        if (vm.count("bus"))
+        {
+            i2c_adapters = vm["bus"].as<std::vector<std::string> >();
+            if (verbose)
+                for (std::string const &i2c_adapter : i2c_adapters)
+                    std::cout << "used i2c adapter is " << i2c_adapter << ".\n";
+        }
+
         if (vm.count("d_device"))
         {
             display_device_address = vm["d_device"].as<int>();
@@ -92,52 +265,356 @@ int main(int ac, char **av)
         return 1;
     }
 
-    std::map<short, DS1631> ds1631_map;
+    // trace events are formatted by a background thread - flushed when main returns. They go to
+    // std::cerr, so they do not split the lines main writes to std::cout.
+    tracer::Session trace_session(verbose ? TRACE_LEVEL_DEBUG : TRACE_LEVEL_ERROR, std::cerr);
+
+    // one file descriptor for all devices on the adapter - closed when main returns
+    std::unique_ptr<I2C_Bus> bus;
+    I2C_SimBus *sim_bus = nullptr;
+    std::vector<I2C_SimBus *> sim_buses;
+    std::vector<std::unique_ptr<DS1631_Sim> > sim_sensors;
+    auto simulated_bus = [&](std::string const &name) -> I2C_SimBus * {
+        I2C_SimBus *simulated = new I2C_SimBus(name);
+        for (short address : {0x48, 0x4b, 0x4c, 0x4f})
+        {
+            sim_sensors.emplace_back(new DS1631_Sim(20.0 + (address & 0x7) * 0.5 + sim_buses.size()));
+            simulated->Attach(address, sim_sensors.back().get());
+        }
+        sim_buses.push_back(simulated);
+        return simulated;
+    };
+    if (simulate)
+    {
+        sim_bus = simulated_bus(i2c_adapters[0]);
+        bus.reset(sim_bus);
+    }
+    else if (!replay_file.empty())
+    {
+        I2C_ReplayBus *replay_bus = new I2C_ReplayBus(replay_file);
+        replay_bus->SetTiming(replay_speed, false);
+        bus.reset(replay_bus);
+    }
+    else
+    {
+        bus.reset(new I2C_Bus(i2c_adapters[0]));
+    }
 
-    I2C_Device i2c_device_48(0x48, verbose);
-    DS1631 ds1631_48(&i2c_device_48);
-    ds1631_map.insert(std::pair<short, DS1631>(0x48, ds1631_48));
+    // optional capture of everything sent over the bus
+    std::unique_ptr<I2C_RecordingBus> recorder;
+    if (!record_file.empty())
+    {
+        recorder.reset(new I2C_RecordingBus(*bus, record_file));
+    }
+    I2C_Bus &i2c_bus = recorder ? *recorder : *bus;
+
+    // further adapters only carry sensors - they are neither recorded nor replayed
+    std::vector<std::unique_ptr<I2C_Bus> > sensor_buses_owned;
+    std::vector<I2C_Bus *> sensor_buses(1, &i2c_bus);
+    for (size_t i = 1; i < i2c_adapters.size(); i++)
+    {
+        if (!replay_file.empty())
+        {
+            std::cout << "replay serves " << i2c_adapters[0] << " only - " << i2c_adapters[i] << " is not used." << std::endl;
+            continue;
+        }
+        if (simulate)
+            sensor_buses_owned.emplace_back(simulated_bus(i2c_adapters[i]));
+        else
+            sensor_buses_owned.emplace_back(new I2C_Bus(i2c_adapters[i]));
+        sensor_buses.push_back(sensor_buses_owned.back().get());
+    }
+    if (timeout >= 0)
+    {
+        for (I2C_Bus *sensor_bus : sensor_buses)
+            sensor_bus->SetTimeout(timeout);
+    }
+    if (bus_retries >= 0)
+    {
+        for (I2C_Bus *sensor_bus : sensor_buses)
+            sensor_bus->SetRetries(bus_retries);
+    }
+
+    // optional scheduler in front of the bus - devices get a handle of their traffic class
+    std::unique_ptr<I2C_Scheduler> scheduler;
+    std::vector<std::unique_ptr<I2C_Interface> > scheduled_devices;
+    if (schedule)
+    {
+        scheduler.reset(new I2C_Scheduler());
+    }
+    auto route = [&](I2C_Device &device, I2C_Class cls) -> I2C_Interface * {
+        if (!scheduler)
+            return &device;
+        scheduled_devices.emplace_back(new I2C_ScheduledDevice(*scheduler, device, cls));
+        return scheduled_devices.back().get();
+    };
+
+    // all sensors are taken from the inventory - probed once, then read from the cache.
+    // Simulated adapters are always probed and never cached.
+    I2C_Inventory inventory;
+    if (discover || (ds1631_device_address == 0))
+    {
+        bool cached = !simulate && !discover && inventory.Load(inventory_file);
+        bool scanned = false;
+        for (I2C_Bus *sensor_bus : sensor_buses)
+        {
+            if (!cached || !inventory.hasAdapter(sensor_bus->getAdapter()))
+            {
+                inventory.Scan(*sensor_bus);
+                scanned = true;
+            }
+        }
+        if (scanned && !simulate && replay_file.empty())
+        {
+            inventory.Save(inventory_file);
+        }
+        if (discover || verbose)
+        {
+            inventory.Print(std::cout);
+            std::cout << std::dec << "discovery: " << inventory.getTransfers() << " transfers" << std::endl;
+        }
+    }
 
-    I2C_Device i2c_device_4b(0x4b, verbose);
-    DS1631 ds1631_4b(&i2c_device_4b);
-    ds1631_map.insert(std::pair<short, DS1631>(0x4b, ds1631_4b));
+    // steady state must not touch the heap: one warm-up cycle, then counted cycles
+    bool allocation_free = true;
+    auto check_allocations = [&](char const *name, std::function<void()> cycle) {
+        static const int Cycles = 10;
+        cycle();
+        unsigned long before = heap_allocations.load();
+        for (int i = 0; i < Cycles; i++)
+            cycle();
+        unsigned long allocations = heap_allocations.load() - before;
+        std::cout << std::dec << "alloc-check " << name << ": " << allocations << " allocations in " << Cycles << " cycles" << std::endl;
+        allocation_free = allocation_free && (allocations == 0);
+    };
 
-    I2C_Device i2c_device_4c(0x4c, verbose);
-    DS1631 ds1631_4c(&i2c_device_4c);
-    ds1631_map.insert(std::pair<short, DS1631>(0x4c, ds1631_4c));
+    // only the requested sensors are built; the adapters are swept in parallel
+    std::vector<std::unique_ptr<I2C_Device> > sensor_devices;
+    std::vector<std::vector<DS1631 *> > sensors_per_bus(sensor_buses.size());
+    std::vector<std::unique_ptr<DS1631> > ds1631_sensors;
+    DS1631_Sampler sampler;
+    sampler.AddBus(i2c_bus, scheduler.get());
+    for (size_t bus_index = 0; bus_index < sensor_buses.size(); bus_index++)
+    {
+        I2C_Bus *sensor_bus = sensor_buses[bus_index];
+        std::vector<int> addresses;
+        if (ds1631_device_address == 0)
+            addresses = inventory.Find(sensor_bus->getAdapter(), I2C_TYPE_DS1631);
+        else if (ds1631_device_address != -1)
+            addresses.push_back(ds1631_device_address);
 
-    I2C_Device i2c_device_4f(0x4f, verbose);
-    DS1631 ds1631_4f(&i2c_device_4f);
-    ds1631_map.insert(std::pair<short, DS1631>(0x4f, ds1631_4f));
+        for (int address : addresses)
+        {
+            sensor_devices.emplace_back(new I2C_Device(*sensor_bus, address));
+            sensor_devices.back()->SetRetryPolicy(retry_policy);
+            // only the first adapter is shared with the display and goes through the scheduler
+            I2C_Interface *device = (sensor_bus == &i2c_bus) ? route(*sensor_devices.back(), I2C_CLASS_SENSOR) : sensor_devices.back().get();
+            ds1631_sensors.emplace_back(new DS1631(device));
+            sampler.AddSensor(*sensor_bus, ds1631_sensors.back().get());
+            sensors_per_bus[bus_index].push_back(ds1631_sensors.back().get());
+        }
+    }
 
     if(ds1631_device_address != -1)
     {
-        for (auto &ds1631_elem : ds1631_map)
+        DS1631_SampleSet sample_set;
+        sampler.Sweep(sample_set);
+
+        for (DS1631_Sample const &sample : sample_set.samples)
         {
-            if ((ds1631_device_address == ds1631_elem.first) || (ds1631_device_address == 0))
+            if (sensor_buses.size() > 1)
             {
-                ds1631_elem.second.StartConvert();
+                std::cout << sample.adapter << "/";
+            }
+            if (!sample.valid)
+            {
+                std::cout << sample.address << ":no data" << std::endl;
+            }
+            else if (verbose)
+            {
+                std::cout << "(0x" << std::hex << sample.address << "): Temp="   << sample.Celsius() << std::endl;
+                DS1631_Status status = sample.sensor->ReadStatus();
+                std::cout << "(0x" << std::hex << sample.address << "): Config=" << status.config << std::dec
+                          << " resolution=" << status.resolutionBits << "bit conversion=" << status.conversionTime.count() << "us"
+                          << (status.tempHighFlag ? " THF" : "") << (status.tempLowFlag ? " TLF" : "") << std::endl;
+            }
+            else
+            {
+                std::cout << sample.address << ":" << std::setprecision(4) << sample.Celsius() << std::endl;
+            }
+        }
+        if (verbose)
+        {
+            std::cout << std::dec << "sweep of " << sampler.getBusCount() << " adapter(s): " << sample_set.duration.count()
+                      << "us, busiest adapter " << sample_set.busiest.count() << "us, conversion wait "
+                      << sample_set.waited.count() << "us, skew " << sample_set.skew.count() << "us" << std::endl;
+        }
+        if (adaptive_seconds > 0)
+        {
+            std::vector<std::unique_ptr<DS1631_Adaptive> > policies;
+            for (std::unique_ptr<DS1631> &sensor : ds1631_sensors)
+                policies.emplace_back(new DS1631_Adaptive(*sensor));
+
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::seconds(adaptive_seconds);
+            while (!policies.empty())
+            {
+                DS1631_Adaptive *next = policies.front().get();
+                for (std::unique_ptr<DS1631_Adaptive> &policy : policies)
+                {
+                    if (policy->NextSample() < next->NextSample())
+                        next = policy.get();
+                }
+                if (next->NextSample() >= end)
+                    break;
+                std::this_thread::sleep_until(next->NextSample());
+                DS1631_Reading reading = next->Sample();
                 if (verbose)
                 {
-                    std::cout << "(0x" << std::hex << ds1631_elem.first << "): Temp="   << ds1631_elem.second.ReadTemperature() << std::endl;
-                    std::cout << "(0x" << std::hex << ds1631_elem.first << "): Config=" << ds1631_elem.second.ReadConfig()      << std::endl;
+                    std::cout << std::hex << reading.address << ":" << std::dec << reading.Celsius()
+                              << (next->isFast() ? " fast" : " slow") << std::endl;
                 }
-                else
+            }
+            for (size_t i = 0; i < policies.size(); i++)
+            {
+                std::cout << std::hex << "adaptive 0x" << sensor_devices[i]->getAddress() << ": ";
+                policies[i]->Print(std::cout);
+            }
+        }
+        if (alarm_seconds > 0)
+        {
+            // sensors are added first - arming then updates their trip points without reading them back
+            DS1631_AlarmMonitor monitor;
+            for (size_t bus_index = 0; bus_index < sensor_buses.size(); bus_index++)
+            {
+                for (DS1631 *sensor : sensors_per_bus[bus_index])
+                    monitor.AddSensor(*sensor_buses[bus_index], sensor);
+            }
+            for (size_t bus_index = 0; bus_index < sensor_buses.size(); bus_index++)
+            {
+                for (DS1631 *sensor : sensors_per_bus[bus_index])
                 {
-                    std::cout << ds1631_device_address << ":" << std::setprecision(4) << ds1631_elem.second.ReadTemperature() << std::endl;
+                    DS1631_Temperature high, low;
+                    if (!std::isnan(alarm_high))
+                        high = DS1631_Temperature::FromCelsius(alarm_high);
+                    else
+                        sensor->ReadUpperTempTripPoint(high);
+                    if (!std::isnan(alarm_low))
+                        low = DS1631_Temperature::FromCelsius(alarm_low);
+                    else
+                        sensor->ReadLowerTempTripPoint(low);
+                    monitor.Arm(*sensor, high, low, sensor->ReadStatus().toutPolarityHigh);
                 }
-                
-        /*
-                ds1631_elem.second.ReadUpperTempTripPoint();
-                ds1631_elem.second.WriteUpperTempTripPoint(30.4);
-                ds1631_elem.second.ReadUpperTempTripPoint();
-
-                ds1631_elem.second.ReadLowerTempTripPoint();
-                ds1631_elem.second.WriteLowerTempTripPoint(20.6);
-                ds1631_elem.second.ReadLowerTempTripPoint();
-                */
             }
+
+            std::vector<DS1631_AlarmEvent> events;
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point end = next + std::chrono::seconds(alarm_seconds);
+            while (next < end)
+            {
+                std::this_thread::sleep_until(next);
+                next += std::chrono::seconds(1);
+                monitor.Poll(events);
+                for (DS1631_AlarmEvent const &event : events)
+                {
+                    if (sensor_buses.size() > 1)
+                    {
+                        std::cout << event.adapter << "/";
+                    }
+                    std::cout << event.address << ":" << (event.high ? " high" : "") << (event.low ? " low" : "")
+                              << " alarm " << std::setprecision(4) << event.reading.Celsius() << std::endl;
+                }
+            }
+            monitor.Print(std::cout);
+        }
+        if (readers > 0)
+        {
+            // every reader accepts one second old values - they share one bus read per conversion
+            static const int Rounds = 10;
+            std::vector<std::unique_ptr<DS1631_SampleCache> > caches;
+            for (std::unique_ptr<DS1631> &sensor : ds1631_sensors)
+                caches.emplace_back(new DS1631_SampleCache(*sensor));
+            std::vector<std::thread> threads;
+            for (int reader = 0; reader < readers; reader++)
+            {
+                threads.emplace_back([&caches] {
+                    for (int round = 0; round < Rounds; round++)
+                    {
+                        for (std::unique_ptr<DS1631_SampleCache> &cache : caches)
+                            cache->Read(std::chrono::seconds(1));
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    }
+                });
+            }
+            for (std::thread &thread : threads)
+                thread.join();
+            for (size_t i = 0; i < caches.size(); i++)
+            {
+                std::cout << std::hex << "cache 0x" << sensor_devices[i]->getAddress() << std::dec << ": "
+                          << caches[i]->getHits() + caches[i]->getMisses() << " reads, "
+                          << caches[i]->getMisses() << " from the sensor" << std::endl;
+            }
+        }
+        if ((history_seconds > 0) && ds1631_sensors.empty())
+        {
+            std::cout << "no DS1631 device - no history recorded." << std::endl;
         }
+        else if (history_seconds > 0)
+        {
+            // one history per sensor, fed by the sweeps - consumers query the rollups without bus access
+            static const size_t HistoryCapacity = 3600;
+            std::map<DS1631 *, std::unique_ptr<DS1631_History> > histories;
+            for (std::unique_ptr<DS1631> &sensor : ds1631_sensors)
+                histories[sensor.get()].reset(new DS1631_History(HistoryCapacity));
+
+            // one sweep per conversion of the slowest sensor - sweeping faster only reads the same samples again
+            std::chrono::microseconds period(0);
+            for (std::unique_ptr<DS1631> &sensor : ds1631_sensors)
+                period = std::max(period, sensor->ConversionTime());
+
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::time_point end = next + std::chrono::seconds(history_seconds);
+            while (next < end)
+            {
+                std::this_thread::sleep_until(next);
+                next += period;
+                sampler.Sweep(sample_set);
+                for (DS1631_Sample const &sample : sample_set.samples)
+                {
+                    if (sample.valid)
+                        histories[sample.sensor]->Add(sample.timestamp, sample.value);
+                }
+            }
+            for (size_t i = 0; i < ds1631_sensors.size(); i++)
+            {
+                std::cout << std::hex << "history 0x" << sensor_devices[i]->getAddress() << ": ";
+                histories[ds1631_sensors[i].get()]->Print(std::cout);
+            }
+        }
+        if (alloc_check)
+        {
+            std::vector<DS1631_Reading> readings;
+            check_allocations("sensors", [&] {
+                for (size_t i = 0; i < sensor_buses.size(); i++)
+                {
+                    DS1631::StartConvertAll(*sensor_buses[i], sensors_per_bus[i]);
+                    DS1631::ReadTemperatureAll(*sensor_buses[i], sensors_per_bus[i], readings);
+                    for (DS1631 *sensor : sensors_per_bus[i])
+                        sensor->Read();
+                }
+            });
+        }
+        /*
+        for (auto sensor : sensors)
+        {
+                sensor->ReadUpperTempTripPoint();
+                sensor->WriteUpperTempTripPoint(30.4);
+                sensor->ReadUpperTempTripPoint();
+
+                sensor->ReadLowerTempTripPoint();
+                sensor->WriteLowerTempTripPoint(20.6);
+                sensor->ReadLowerTempTripPoint();
+        }
+        */
     }
 
     std::map<short, PcfLcd> PcfLcd_map;
@@ -146,30 +623,120 @@ int main(int ac, char **av)
     {
         short I2C_Address = PCF_Addr[display_device_address];
         std::cout << "Display (" << display_device_address << ") == (0x" << std::hex << I2C_Address << ") is used."  << std::endl;
-        I2C_Device display_device(I2C_Address, verbose);
-        PcfLcd display(&display_device, display_device_address, true);
+        I2C_Device display_device(i2c_bus, I2C_Address);
+        display_device.SetRetryPolicy(retry_policy);
+
+        // on the simulated bus an emulated display accounts the traffic of every call
+        std::unique_ptr<PcfLcd_Sim> lcd_sim;
+        if (sim_bus)
+        {
+            lcd_sim.reset(new PcfLcd_Sim());
+            sim_bus->Attach(I2C_Address, lcd_sim.get());
+        }
+        auto measure = [&](std::string const &call, std::function<void()> action) {
+            if (lcd_sim)
+                lcd_sim->Measure(call, action);
+            else
+                action();
+        };
+
+        // queued output needs a bus worker - without -s the display gets one of its own,
+        // so the caller keeps running while the async output is sent
+        std::unique_ptr<I2C_Scheduler> display_worker;
+        std::unique_ptr<I2C_ScheduledDevice> display_queue;
+        I2C_Interface *display_interface;
+        if (scheduler)
+        {
+            display_interface = route(display_device, I2C_CLASS_DISPLAY);
+        }
+        else
+        {
+            display_worker.reset(new I2C_Scheduler());
+            display_queue.reset(new I2C_ScheduledDevice(*display_worker, display_device, I2C_CLASS_DISPLAY));
+            display_interface = display_queue.get();
+        }
+
+        std::unique_ptr<PcfLcd> display_ptr;
+        measure("init", [&] { display_ptr.reset(new PcfLcd(display_interface, display_device_address, true)); });
+        PcfLcd &display = *display_ptr;
         PcfLcd_map.insert(std::pair<short, PcfLcd>(I2C_Address, display));
 
-        display.home();
-        display.put('A');
-        display.put('b');
-        display.put('c');
-        display.put('-');
-        display.print2("String");
-        display.put('-');
+        measure("home", [&] { display.home(); });
+        measure("put", [&] { display.put('A'); });
+        measure("put", [&] { display.put('b'); });
+        measure("put", [&] { display.put('c'); });
+        measure("put", [&] { display.put('-'); });
+        measure("print2", [&] { display.print2("String"); });
+        measure("put", [&] { display.put('-'); });
+
+        measure("line", [&] { display.line(1); });
+        measure("zahl(int)", [&] { display.zahl(12345); });
+        measure("put", [&] { display.put('-'); });
+        measure("zahl(int)", [&] { display.zahl(-4321); });
+        measure("put", [&] { display.put('-'); });
+        measure("zahl(float)", [&] { display.zahl(678.90,2); });
 
-        display.line(1);
-        display.zahl(12345);
-        display.put('-');
-        display.zahl(-4321);
-        display.put('-');
-        display.zahl(678.90,2);
+        measure("line", [&] { display.line(2); });
+        measure("time", [&] { display.time(1); });
 
-        display.line(2);
-        display.time(1);
+        measure("line", [&] { display.line(3); });
+        measure("date", [&] { display.date(2); });
+
+        // queued output runs on the bus worker while the caller keeps writing
+        measure("print2Async", [&] {
+            std::future<bool> text = display.print2Async(" async");
+            display.updateAsync([](PcfLcd &lcd) { lcd.put('!'); });
+            display.line(0);
+            display.put('>');
+            text.wait();
+        });
+
+        if (lcd_sim)
+        {
+            std::cout << lcd_sim->Snapshot();
+            lcd_sim->PrintMeasurements(std::cout);
+        }
+        if (alloc_check)
+        {
+            check_allocations("display", [&] {
+                display.home();
+                display.print2("String");
+                display.line(1);
+                display.zahl(-4321);
+                display.put('-');
+                display.zahl(678.90, 2);
+                display.line(2);
+                display.time(3);
+                display.line(3);
+                display.date(0);
+            });
+        }
+        if (stats)
+        {
+            display_device.PrintStats(std::cout);
+        }
+    }
 
-        display.line(3);
-        display.date(2);
+    if (stats)
+    {
+        for (std::unique_ptr<I2C_Device> const &device : sensor_devices)
+            device->PrintStats(std::cout);
+        for (size_t i = 0; i < ds1631_sensors.size(); i++)
+        {
+            std::cout << std::hex << "0x" << sensor_devices[i]->getAddress() << std::dec << " EEPROM writes="
+                      << ds1631_sensors[i]->getNvmWrites() << " skipped=" << ds1631_sensors[i]->getNvmWritesSkipped() << std::endl;
+        }
+    }
+    if (scheduler)
+    {
+        scheduler->PrintStats(std::cout);
+    }
+    for (I2C_SimBus *simulated : sim_buses)
+    {
+        I2C_SimStats sim_stats = simulated->GetStats();
+        std::cout << std::dec << simulated->getAdapter() << ": transfers=" << sim_stats.transfers << " messages=" << sim_stats.messages
+                  << " bytes=" << sim_stats.bytes << " nacks=" << sim_stats.nacks
+                  << " bus time=" << sim_stats.busTime.count() << "us" << std::endl;
     }
-    return (0);
+    return (allocation_free ? 0 : 1);
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+/**
+ * @file tracer.cpp
+ * @author Michael Rossner (Schrott.Micha@web.de)
+ * @brief lock-free trace ring buffer and its drain thread
+ * @version 0.1
+ * @date 2019-06-12
+ * 
+ * @copyright Copyright (c) 2019
+ * MIT license - see license file
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+#include "tracer.hpp"
+
+namespace
+{
+    /**
+     * @brief bounded multi-producer/single-consumer ring (Vyukov).
+     *        Producers never block; a full ring drops the event.
+     * 
+     */
+    const size_t RingSize = 4096; // power of two
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        tracer::Event event;
+    };
+
+    struct Ring
+    {
+        Ring() : enqueuePos(0), dequeuePos(0), dropped(0)
+        {
+            for (size_t i = 0; i < RingSize; i++)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        bool Push(tracer::Event const &event)
+        {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true)
+            {
+                cell = &cells[pos & (RingSize - 1)];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                long diff = (long)sequence - (long)pos;
+                if (diff == 0)
+                {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                else
+                {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->event = event;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool Pop(tracer::Event &event)
+        {
+            Cell *cell = &cells[dequeuePos & (RingSize - 1)];
+            if (cell->sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+                return false;
+            event = cell->event;
+            cell->sequence.store(dequeuePos + RingSize, std::memory_order_release);
+            dequeuePos++;
+            return true;
+        }
+
+        Cell cells[RingSize];
+        std::atomic<size_t> enqueuePos;
+        size_t dequeuePos; // only touched by the drain thread
+        std::atomic<unsigned long> dropped;
+    };
+
+    Ring ring;
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    std::mutex control; // Start/Stop only - never taken by producers
+    std::thread drain;
+    std::atomic<bool> running(false);
+    std::ostream *output = nullptr;
+
+    char const *const LevelName[] = {"", "E", "I", "D"};
+
+    /**
+     * @brief fixed size line, appending never overflows (output is cut)
+     */
+    struct Line
+    {
+        Line() : pos(0) { text[0] = '\0'; }
+
+        template <typename... Args>
+        void Append(char const *format, Args... args)
+        {
+            int room = (int)sizeof(text) - pos;
+            if (room <= 1)
+                return;
+            int written = std::snprintf(text + pos, room, format, args...);
+            if (written > 0)
+                pos += (written < room) ? written : room - 1;
+        }
+
+        char text[256];
+        int pos;
+    };
+
+    /**
+     * @brief format one event into a line without heap allocations
+     */
+    void Print(tracer::Event const &event, std::ostream &out)
+    {
+        Line line;
+        line.Append("%12.6f %s %s::%s", event.time / 1e9, LevelName[event.level & 3], event.component, event.function);
+        if (event.address != TRACE_NO_ADDRESS)
+            line.Append("(0x%x)", event.address);
+        line.Append(" ");
+
+        int arg = 0;
+        for (char const *f = event.format; *f; f++)
+        {
+            bool hex = (f[0] == '{') && (f[1] == 'x') && (f[2] == '}');
+            if (((f[0] == '{') && (f[1] == '}')) || hex)
+            {
+                if (arg < event.numArgs)
+                {
+                    tracer::Arg const &value = event.args[arg++];
+                    if (value.real)
+                        line.Append("%g", value.floating);
+                    else if (hex)
+                        line.Append("0x%llx", value.integer);
+                    else
+                        line.Append("%lld", value.integer);
+                }
+                f += hex ? 2 : 1;
+                continue;
+            }
+            line.Append("%c", *f);
+        }
+        for (int i = 0; i < event.numBytes; i++)
+        {
+            line.Append(" %02x", event.bytes[i]);
+        }
+        out << line.text << '\n';
+    }
+
+    /**
+     * @brief print everything pending; one flush per batch
+     */
+    void DrainPending(std::ostream &out)
+    {
+        tracer::Event event;
+        bool printed = false;
+        while (ring.Pop(event))
+        {
+            Print(event, out);
+            printed = true;
+        }
+        if (printed)
+            out.flush();
+    }
+
+    void DrainLoop()
+    {
+        while (running.load(std::memory_order_acquire))
+        {
+            DrainPending(*output);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        DrainPending(*output);
+    }
+}
+
+std::atomic<int> &tracer::currentLevel()
+{
+    static std::atomic<int> level(TRACE_LEVEL_ERROR);
+    return level;
+}
+
+void tracer::Fill(Event &event, int level, char const *component, char const *function, int address, char const *format)
+{
+    event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    event.level = level;
+    event.address = address;
+    event.component = component;
+    event.function = function;
+    event.format = format;
+    event.numArgs = 0;
+    event.numBytes = 0;
+}
+
+void tracer::Push(Event const &event)
+{
+    ring.Push(event);
+}
+
+/**
+ * @brief start the background thread printing the events
+ * 
+ * @param out stream receiving the formatted events
+ */
+void tracer::Start(std::ostream &out)
+{
+    std::lock_guard<std::mutex> guard(control);
+    if (running.load())
+        return;
+    output = &out;
+    running.store(true, std::memory_order_release);
+    drain = std::thread(DrainLoop);
+}
+
+/**
+ * @brief stop the background thread after printing all pending events
+ */
+void tracer::Stop()
+{
+    std::lock_guard<std::mutex> guard(control);
+    if (!running.load())
+        return;
+    running.store(false, std::memory_order_release);
+    drain.join();
+}
+
+/**
+ * @brief number of events lost because the ring was full
+ */
+unsigned long tracer::getDropped()
+{
+    return ring.dropped.load(std::memory_order_relaxed);
+}
@@ -1,7 +1,8 @@
 /**
  * @file tracer.hpp
  * @author Michael Rossner (Schrott.Micha@web.de)
- * @brief 
+ * @brief leveled tracing - binary events in a lock-free ring buffer,
+ *        formatted by a background thread
  * @version 0.1
  * @date 2019-06-12
  * 
@@ -9,23 +10,166 @@
  * MIT license - see license file
  */
 
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+
+#define TRACE_LEVEL_OFF   0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO  2
+#define TRACE_LEVEL_DEBUG 3
+
+// highest level compiled in - events above it do not generate any code
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+
+// name printed in front of the function, define before including this file
+#ifndef TRACE_COMPONENT
+#define TRACE_COMPONENT ""
+#endif
+
+// address argument for events not related to a single device
+#define TRACE_NO_ADDRESS (-1)
+
+/*
+ * TRACE_xxx(address, format, args...)
+ *   format is a string literal, "{}" prints the next argument, "{x}" prints it hex.
+ *   At most TRACE_MAX_ARGS integral or floating point arguments.
+ * TRACE_BYTES_xxx(address, buffer, length)
+ *   the first TRACE_MAX_BYTES bytes of a buffer.
+ */
+#if TRACE_COMPILE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(address, ...) tracer::Log(TRACE_LEVEL_ERROR, TRACE_COMPONENT, __func__, address, __VA_ARGS__)
+#else
+#define TRACE_ERROR(address, ...) do {} while (0)
+#endif
+
+#if TRACE_COMPILE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(address, ...) tracer::Log(TRACE_LEVEL_INFO, TRACE_COMPONENT, __func__, address, __VA_ARGS__)
+#else
+#define TRACE_INFO(address, ...) do {} while (0)
+#endif
+
+#if TRACE_COMPILE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(address, ...) tracer::Log(TRACE_LEVEL_DEBUG, TRACE_COMPONENT, __func__, address, __VA_ARGS__)
+#define TRACE_BYTES_DEBUG(address, buffer, length) tracer::LogBytes(TRACE_LEVEL_DEBUG, TRACE_COMPONENT, __func__, address, buffer, length)
+#else
+#define TRACE_DEBUG(address, ...) do {} while (0)
+#define TRACE_BYTES_DEBUG(address, buffer, length) do {} while (0)
+#endif
+
 class tracer
 {
-    tracer(int logLevel){_logLevel=logLevel;}
-    ~tracer();
-
-    bool checkLoglevel(int logLevel){
-            if(logLevel>_logLevel)
-            { 
-                return true;
-            }
-            else
-            {
-                    return false;
-            }
+public:
+    static const int TRACE_MAX_ARGS = 4;
+    static const int TRACE_MAX_BYTES = 16;
+
+    /**
+     * @brief argument of an event - kept binary until the event is printed
+     * 
+     */
+    struct Arg
+    {
+        bool real;
+        union
+        {
+            long long integer;
+            double floating;
+        };
+    };
+
+    /**
+     * @brief one trace event - plain data, only pointers to string literals
+     * 
+     */
+    struct Event
+    {
+        long long time;
+        int level;
+        int address;
+        char const *component;
+        char const *function;
+        char const *format;
+        int numArgs;
+        Arg args[TRACE_MAX_ARGS];
+        int numBytes;
+        unsigned char bytes[TRACE_MAX_BYTES];
+    };
+
+    static void setLogLevel(int logLevel){currentLevel().store(logLevel, std::memory_order_relaxed);}
+    static int getLogLevel(){return currentLevel().load(std::memory_order_relaxed);}
+    static bool checkLoglevel(int logLevel){return logLevel <= getLogLevel();}
+
+    static void Start(std::ostream &out);
+    static void Stop();
+    static unsigned long getDropped();
+
+    template <typename... Args>
+    static void Log(int level, char const *component, char const *function, int address, char const *format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= TRACE_MAX_ARGS, "too many trace arguments");
+        if (!checkLoglevel(level))
+            return;
+        Event event;
+        Fill(event, level, component, function, address, format);
+        Arg values[sizeof...(Args) + 1] = {MakeArg(args)..., MakeArg(0)};
+        event.numArgs = sizeof...(Args);
+        for (int i = 0; i < event.numArgs; i++)
+            event.args[i] = values[i];
+        Push(event);
     }
-    void setLogLevel(int logLevel){_logLevel=logLevel;}
-            
+
+    static void LogBytes(int level, char const *component, char const *function, int address, unsigned char const *buffer, int length)
+    {
+        if (!checkLoglevel(level))
+            return;
+        Event event;
+        Fill(event, level, component, function, address, "{} bytes");
+        event.numArgs = 1;
+        event.args[0] = MakeArg(length);
+        event.numBytes = (length < TRACE_MAX_BYTES) ? length : TRACE_MAX_BYTES;
+        std::memcpy(event.bytes, buffer, event.numBytes);
+        Push(event);
+    }
+
+    /**
+     * @brief RAII helper - starts the drain thread and stops it (flushing
+     *        all pending events) at the end of the scope
+     * 
+     */
+    class Session
+    {
+    public:
+        Session(int logLevel, std::ostream &out){setLogLevel(logLevel); Start(out);}
+        ~Session(){Stop();}
+    };
+
 private:
-    int _logLevel;
-};
\ No newline at end of file
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, Arg>::type MakeArg(T value)
+    {
+        Arg arg;
+        arg.real = true;
+        arg.floating = value;
+        return arg;
+    }
+
+    template <typename T>
+    static typename std::enable_if<!std::is_floating_point<T>::value, Arg>::type MakeArg(T value)
+    {
+        Arg arg;
+        arg.real = false;
+        arg.integer = static_cast<long long>(value);
+        return arg;
+    }
+
+    static std::atomic<int> &currentLevel();
+    static void Fill(Event &event, int level, char const *component, char const *function, int address, char const *format);
+    static void Push(Event const &event);
+};